@@ -0,0 +1,258 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include "bounded_queue.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// -------------------------------- Batch Items --------------------------------
+// -----------------------------------------------------------------------------
+// Item passed through stages (released step by step)
+struct BatchItem {
+    BatchResult result;
+    std::shared_ptr<const Mesh> mesh;
+    std::vector<RenderedFrame> frames;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+using Clock = std::chrono::steady_clock;
+
+float GetElapsedMs(const Clock::time_point& start) {
+    return std::chrono::duration<float, std::milli>(Clock::now() - start)
+            .count();
+}
+
+// Runs `func` on `n_threads` threads, then calls `on_exit` once after all of
+// them exited
+template <typename Func, typename OnExit>
+std::vector<std::thread> SpawnStage(uint32_t n_threads, Func func,
+                                    OnExit on_exit) {
+    auto n_running = std::make_shared<std::atomic<uint32_t>>(n_threads);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < n_threads; i++) {
+        threads.emplace_back([=]() {
+            func();
+            if (n_running->fetch_sub(1) == 1) {
+                on_exit();
+            }
+        });
+    }
+    return threads;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Rendered Frame ------------------------------
+// -----------------------------------------------------------------------------
+RenderedFrame CopyFrame(const FrameView& view) {
+    const ByteImageView& color = view.color;
+    const size_t n_bytes = size_t(color.width) * color.height * color.n_ch;
+    RenderedFrame frame;
+    frame.color.pixels.assign(color.pixels, color.pixels + n_bytes);
+    frame.color.width = color.width;
+    frame.color.height = color.height;
+    frame.color.n_ch = color.n_ch;
+    frame.mvpc_mat = view.mvpc_mat;
+    return frame;
+}
+
+std::vector<Landmark> DetectRenderedFrames(
+        LandmarkDetector& detector, const std::vector<RenderedFrame>& frames,
+        const Mesh& mesh) {
+    std::vector<std::vector<Landmark>> view_lmks;
+    for (auto&& rendered : frames) {
+        FrameView frame;
+        frame.color = GetView(rendered.color);
+        frame.mvpc_mat = rendered.mvpc_mat;
+        view_lmks.push_back(detector.detect(frame, mesh));
+    }
+    return FuseLandmarks(view_lmks);
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Batch Pipeline ------------------------------
+// -----------------------------------------------------------------------------
+std::vector<std::string> ListMeshFiles(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> filenames;
+
+    // Directory
+    if (fs::is_directory(path)) {
+        for (auto&& entry : fs::directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".obj") {
+                filenames.push_back(entry.path().string());
+            }
+        }
+        std::sort(filenames.begin(), filenames.end());
+        return filenames;
+    }
+
+    // Manifest
+    std::ifstream ifs(path);
+    if (!ifs) {
+        throw std::runtime_error("Failed to open mesh list: " + path);
+    }
+    const fs::path base_dir = fs::path(path).parent_path();
+    std::string line;
+    while (std::getline(ifs, line)) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const fs::path filename(line);
+        filenames.push_back(filename.is_absolute() ?
+                                    filename.string() :
+                                    (base_dir / filename).string());
+    }
+    return filenames;
+}
+
+void RunBatch(const std::vector<std::string>& filenames, Renderer& renderer,
+              LandmarkDetectorPool& detectors, const BatchConfig& config,
+              const std::function<void(const BatchResult&)>& write) {
+    if (!config.gen_mvp_mats) {
+        throw std::runtime_error("Batch: View matrices are not given");
+    }
+    // Colors are copied out of frames, and 3D points are found by ray casting
+    renderer.setColorFormat(ColorFormat::RGBA8);
+    renderer.setDenseReadback(false);
+
+    BoundedQueue<BatchItem> load_queue(config.queue_size);
+    BoundedQueue<BatchItem> render_queue(config.queue_size);
+    BoundedQueue<BatchItem> write_queue(config.queue_size);
+    auto close_all = [&]() {
+        load_queue.close();
+        render_queue.close();
+        write_queue.close();
+    };
+
+    // Load OBJ and texture in parallel
+    std::atomic<uint32_t> next_idx{0};
+    const uint32_t n_meshes = static_cast<uint32_t>(filenames.size());
+    auto loaders = SpawnStage(
+            std::max(config.n_loaders, 1u),
+            [&]() {
+                uint32_t mesh_idx;
+                while ((mesh_idx = next_idx.fetch_add(1)) < n_meshes) {
+                    BatchItem item;
+                    item.result.mesh_idx = mesh_idx;
+                    item.result.filename = filenames[mesh_idx];
+                    const auto start = Clock::now();
+                    try {
+                        item.mesh = std::make_shared<const Mesh>(LoadMesh(
+                                item.result.filename, config.use_cache));
+                    } catch (const std::exception& e) {
+                        item.result.error = e.what();
+                    }
+                    item.result.load_ms = GetElapsedMs(start);
+                    if (!load_queue.push(std::move(item))) {
+                        return;  // Aborted
+                    }
+                }
+            },
+            [&]() { load_queue.close(); });
+
+    // Render views (the renderer is used by one thread)
+    auto render_stage = SpawnStage(
+            1,
+            [&]() {
+                BatchItem item;
+                while (load_queue.pop(item)) {
+                    if (item.result.error.empty()) {
+                        const auto start = Clock::now();
+                        try {
+                            const std::vector<glm::mat4> mvp_mats =
+                                    config.gen_mvp_mats(*item.mesh);
+                            renderer.setMesh(item.mesh);
+                            // All views by one submission
+                            for (auto&& view :
+                                 renderer.drawBatchViews(mvp_mats)) {
+                                item.frames.push_back(CopyFrame(view));
+                            }
+                        } catch (const std::exception& e) {
+                            item.result.error = e.what();
+                        }
+                        item.result.render_ms = GetElapsedMs(start);
+                    }
+                    if (!render_queue.push(std::move(item))) {
+                        return;  // Aborted
+                    }
+                }
+            },
+            [&]() { render_queue.close(); });
+
+    // Detect landmarks in parallel (detectors share one model)
+    const uint32_t n_detectors =
+            (config.n_detectors == 0) ?
+                    std::max(std::thread::hardware_concurrency(), 1u) :
+                    config.n_detectors;
+    auto detect_stage = SpawnStage(
+            n_detectors,
+            [&]() {
+                BatchItem item;
+                while (render_queue.pop(item)) {
+                    if (item.result.error.empty()) {
+                        const auto start = Clock::now();
+                        try {
+                            auto detector = detectors.acquire();
+                            item.result.landmarks = DetectRenderedFrames(
+                                    *detector, item.frames, *item.mesh);
+                        } catch (const std::exception& e) {
+                            item.result.error = e.what();
+                        }
+                        item.result.detect_ms = GetElapsedMs(start);
+                    }
+                    if (!item.result.error.empty()) {
+                        item.result.status = ResultStatus::FAILED;
+                    } else if (item.result.landmarks.empty()) {
+                        item.result.status = ResultStatus::NO_FACE;
+                    }
+                    item.mesh.reset();
+                    item.frames.clear();
+                    if (!write_queue.push(std::move(item))) {
+                        return;  // Aborted
+                    }
+                }
+            },
+            [&]() { write_queue.close(); });
+
+    // Write results on this thread
+    std::exception_ptr error;
+    try {
+        BatchItem item;
+        while (write_queue.pop(item)) {
+            write(item.result);
+        }
+    } catch (...) {
+        error = std::current_exception();
+        close_all();  // Stop the other stages
+    }
+
+    for (auto&& threads : {&loaders, &render_stage, &detect_stage}) {
+        for (auto&& thread : *threads) {
+            thread.join();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
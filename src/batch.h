@@ -0,0 +1,60 @@
+#ifndef BATCH_H_20210218
+#define BATCH_H_20210218
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "landmarker.h"
+#include "renderer.h"
+#include "result_sink.h"
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Rendered Frame ------------------------------
+// -----------------------------------------------------------------------------
+// Frame copied out of the renderer (its frame slots are reused)
+struct RenderedFrame {
+    ByteImage color;
+    glm::mat4 mvpc_mat;
+};
+
+// Copies RGBA8 color of the view
+RenderedFrame CopyFrame(const FrameView& view);
+
+// Detects landmarks on each view and fuses them by `FuseLandmarks`
+std::vector<Landmark> DetectRenderedFrames(
+        LandmarkDetector& detector, const std::vector<RenderedFrame>& frames,
+        const Mesh& mesh);
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Batch Pipeline ------------------------------
+// -----------------------------------------------------------------------------
+struct BatchConfig {
+    // Views rendered for each mesh (fused by `FuseLandmarks`)
+    std::function<std::vector<glm::mat4>(const Mesh&)> gen_mvp_mats;
+    uint32_t n_loaders = 2;    // Threads loading OBJ and texture
+    uint32_t n_detectors = 0;  // Threads detecting landmarks (0: hardware)
+    uint32_t queue_size = 4;   // Capacity of each queue between stages
+    bool use_cache = true;     // Mesh cache next to OBJ files
+};
+
+// Record of each mesh (landmarks are fused over views)
+using BatchResult = ResultRecord;
+
+// Lists OBJ files in a directory (sorted), or in a manifest file of one path
+// for each line (relative to the manifest, `#` for comments)
+std::vector<std::string> ListMeshFiles(const std::string& path);
+
+// Loads, renders, detects and writes meshes in overlapped stages connected by
+// bounded queues. `write` is called on the calling thread in completion order.
+// Failure of a mesh is reported in its result without stopping the others.
+// The renderer is switched to RGBA8 color without dense readback.
+void RunBatch(const std::vector<std::string>& filenames, Renderer& renderer,
+              LandmarkDetectorPool& detectors, const BatchConfig& config,
+              const std::function<void(const BatchResult&)>& write);
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
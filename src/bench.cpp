@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "image.h"
+#include "landmarker.h"
+#include "log.h"
+#include "renderer.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const std::string DEFAULT_OBJ = "../data/Rhea_45_Small.obj";
+const std::string DEFAULT_TEXTURE = "../data/Rhea_45_Diffuse_Small.jpg";
+const std::string DEFAULT_PREDICTOR =
+        "../data/shape_predictor_5_face_landmarks.dat";
+const uint32_t IMG_W = 600;
+const uint32_t IMG_H = 600;
+const uint32_t TEX_SIZE = 1024;  // Synthetic texture
+// Grid divisions of synthetic spheres ((n + 1)^2 vertices)
+const std::vector<uint32_t> SPHERE_DIVS = {32, 128, 512};
+const uint32_t N_LMK_QUERIES = 68;  // Same as the 68-point predictor
+const uint32_t N_BATCH_VIEWS = 8;   // Views of batched drawing
+const uint32_t N_BATCH_MESHES = 4;  // Meshes of a batch run (same file)
+
+// -----------------------------------------------------------------------------
+// ------------------------------------ Timer ----------------------------------
+// -----------------------------------------------------------------------------
+struct BenchStats {
+    uint32_t n_iters = 0;
+    double min_ms = 0.0, median_ms = 0.0, mean_ms = 0.0;
+};
+
+// Runs `func` once for warm-up, then `n_iters` times
+BenchStats Measure(uint32_t n_iters, const std::function<void()>& func) {
+    using Clock = std::chrono::steady_clock;
+    func();
+    std::vector<double> times;
+    for (uint32_t i = 0; i < n_iters; i++) {
+        const auto start = Clock::now();
+        func();
+        const std::chrono::duration<double, std::milli> elapsed =
+                Clock::now() - start;
+        times.push_back(elapsed.count());
+    }
+    std::sort(times.begin(), times.end());
+    BenchStats stats;
+    stats.n_iters = n_iters;
+    stats.min_ms = times.front();
+    stats.median_ms = times[times.size() / 2];
+    for (auto&& t : times) {
+        stats.mean_ms += t / double(times.size());
+    }
+    return stats;
+}
+
+// Writes one JSON object for each line
+class BenchReporter {
+public:
+    BenchReporter(std::FILE* fp, uint32_t n_iters)
+        : m_fp(fp), m_n_iters(n_iters) {}
+
+    void run(const std::string& name, uint64_t size,
+             const std::function<void()>& func) {
+        const BenchStats stats = Measure(m_n_iters, func);
+        std::fprintf(m_fp,
+                     "{\"name\":\"%s\",\"size\":%llu,\"iters\":%u,"
+                     "\"min_ms\":%.4f,\"median_ms\":%.4f,\"mean_ms\":%.4f}\n",
+                     name.c_str(), static_cast<unsigned long long>(size),
+                     stats.n_iters, stats.min_ms, stats.median_ms,
+                     stats.mean_ms);
+        std::fflush(m_fp);
+    }
+
+private:
+    std::FILE* m_fp;
+    uint32_t m_n_iters;
+};
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Synthetic Data -------------------------------
+// -----------------------------------------------------------------------------
+void WriteTexture(const std::string& filename, uint32_t size) {
+    // Binary PPM (read by stb_image)
+    std::ofstream ofs(filename, std::ios::binary);
+    ofs << "P6\n" << size << " " << size << "\n255\n";
+    std::vector<uint8_t> row(size * 3);
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            row[x * 3 + 0] = static_cast<uint8_t>(x * 255 / size);
+            row[x * 3 + 1] = static_cast<uint8_t>(y * 255 / size);
+            const bool checker = (x / 32 + y / 32) % 2;
+            row[x * 3 + 2] = checker ? uint8_t(255) : uint8_t(0);
+        }
+        ofs.write(reinterpret_cast<const char*>(row.data()),
+                  static_cast<std::streamsize>(row.size()));
+    }
+}
+
+// Writes UV sphere of `(n_div + 1)^2` vertices with texture. Returns OBJ path.
+std::string WriteSphereObj(const std::filesystem::path& dir, uint32_t n_div) {
+    const std::string name = "sphere_" + std::to_string(n_div);
+    const std::string tex_name = "sphere_tex.ppm";
+    if (!std::filesystem::exists(dir / tex_name)) {
+        WriteTexture((dir / tex_name).string(), TEX_SIZE);
+    }
+    {
+        std::ofstream ofs(dir / (name + ".mtl"));
+        ofs << "newmtl sphere\nmap_Kd " << tex_name << "\n";
+    }
+
+    std::ofstream ofs(dir / (name + ".obj"));
+    ofs << "mtllib " << name << ".mtl\nusemtl sphere\n";
+    const float PI = 3.14159265f;
+    for (uint32_t j = 0; j <= n_div; j++) {
+        const float v = float(j) / float(n_div);
+        for (uint32_t i = 0; i <= n_div; i++) {
+            const float u = float(i) / float(n_div);
+            const float theta = u * 2.f * PI;
+            const float phi = v * PI;
+            ofs << "v " << std::sin(phi) * std::cos(theta) << " "
+                << std::cos(phi) << " " << std::sin(phi) * std::sin(theta)
+                << "\nvt " << u << " " << v << "\n";
+        }
+    }
+    for (uint32_t j = 0; j < n_div; j++) {
+        for (uint32_t i = 0; i < n_div; i++) {
+            // 1-origin indices of the quad corners
+            const uint32_t i00 = j * (n_div + 1) + i + 1;
+            const uint32_t i01 = i00 + 1;
+            const uint32_t i10 = i00 + n_div + 1;
+            const uint32_t i11 = i10 + 1;
+            ofs << "f " << i00 << "/" << i00 << " " << i10 << "/" << i10 << " "
+                << i11 << "/" << i11 << "\nf " << i00 << "/" << i00 << " "
+                << i11 << "/" << i11 << " " << i01 << "/" << i01 << "\n";
+        }
+    }
+    return (dir / (name + ".obj")).string();
+}
+
+glm::mat4 GenMvpMatrix(const Mesh& mesh) {
+    // Frontal camera fitting the bounding sphere
+    const glm::vec3 center = (mesh.min_pos + mesh.max_pos) / 2.f;
+    const float radius = glm::distance(mesh.max_pos, mesh.min_pos) / 2.f;
+    const float fov = glm::radians(20.f);
+    const glm::vec3 cam_pos =
+            center + glm::vec3(0.f, 0.f, radius * 1.5f / glm::tan(fov));
+    return glm::perspective(fov, float(IMG_W) / float(IMG_H), 0.1f, 1000.f) *
+           glm::lookAt(cam_pos, center, glm::vec3(0.f, 1.f, 0.f));
+}
+
+// Pixels spread over the center of the image
+std::vector<glm::ivec2> GenQueryPixels(uint32_t n) {
+    std::vector<glm::ivec2> pixels;
+    for (uint32_t i = 0; i < n; i++) {
+        pixels.emplace_back(IMG_W / 4 + (i * 37) % (IMG_W / 2),
+                            IMG_H / 4 + (i * 53) % (IMG_H / 2));
+    }
+    return pixels;
+}
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Benchmarks --------------------------------
+// -----------------------------------------------------------------------------
+void BenchMesh(BenchReporter& reporter, const std::string& obj_filename,
+               const std::string& tag,
+               const std::vector<RenderBackend>& backends) {
+    // Loading (parse without cache, then through cache)
+    std::shared_ptr<const Mesh> mesh;
+    reporter.run("LoadObj" + tag, 0, [&]() {
+        mesh = std::make_shared<const Mesh>(LoadMesh(obj_filename, false));
+    });
+    const uint64_t n_vtxs = mesh->vertices.size();
+    LoadMesh(obj_filename, true);  // Write cache
+    reporter.run("LoadMeshCache" + tag, n_vtxs,
+                 [&]() { LoadMesh(obj_filename, true); });
+
+    // Rendering
+    const glm::mat4 mvp_mat = GenMvpMatrix(*mesh);
+    for (auto&& backend : backends) {
+        const std::string backend_name =
+                (backend == RenderBackend::CPU) ? "Cpu" : "Vulkan";
+        Renderer renderer(IMG_W, IMG_H, backend);
+        renderer.setColorFormat(ColorFormat::RGBA8);
+        renderer.setDenseReadback(false);
+        renderer.setMesh(mesh);
+        reporter.run("Renderer::draw/" + backend_name + tag, n_vtxs, [&]() {
+            renderer.waitDrawView(renderer.submitDraw(mvp_mat));
+        });
+        // Views of a pose sweep, one by one or by one submission
+        const std::vector<glm::mat4> mvp_mats(N_BATCH_VIEWS, mvp_mat);
+        reporter.run("Renderer::drawViews/" + backend_name + tag, n_vtxs,
+                     [&]() {
+                         for (auto&& ticket : renderer.submitDraws(mvp_mats)) {
+                             renderer.waitDrawView(ticket);
+                         }
+                     });
+        reporter.run("Renderer::drawBatch/" + backend_name + tag, n_vtxs,
+                     [&]() { renderer.drawBatchViews(mvp_mats); });
+    }
+
+    FrameView frame;
+    // Surface queries of landmark pixels (ray casting without readback)
+    frame.mvpc_mat = CLIP_MAT * mvp_mat;
+    frame.color_f.width = IMG_W;
+    frame.color_f.height = IMG_H;
+    const std::vector<glm::ivec2> pixels = GenQueryPixels(N_LMK_QUERIES);
+    reporter.run("QuerySurfacePoints" + tag, n_vtxs,
+                 [&]() { QuerySurfacePoints(frame, *mesh, pixels); });
+
+    // Nearest vertex search
+    std::vector<glm::vec3> queries;
+    for (auto&& vtx : mesh->vertices) {
+        queries.push_back(vtx.pos * 1.01f);
+        if (queries.size() == N_LMK_QUERIES) {
+            break;
+        }
+    }
+    reporter.run("KdTree::findNearest" + tag, n_vtxs,
+                 [&]() { mesh->vtx_tree.findNearest(queries); });
+}
+
+void BenchImage(BenchReporter& reporter, const std::string& tex_filename) {
+    ByteImage img;
+    reporter.run("LoadImage", 0, [&]() { img = LoadImage(tex_filename, 4); });
+
+    // Conversion for dlib (frame-sized)
+    ByteImage frame_img = {std::vector<uint8_t>(IMG_W * IMG_H * 4), IMG_W,
+                           IMG_H, 4};
+    FloatImage frame_img_f = CreateImage(IMG_W, IMG_H, 4);
+    dlib::array2d<dlib::rgb_pixel> dlib_img;
+    reporter.run("CastToDlibImg/RGBA8", IMG_W * IMG_H,
+                 [&]() { CastToDlibImg(GetView(frame_img), dlib_img); });
+    reporter.run("CastToDlibImg/RGBA32F", IMG_W * IMG_H,
+                 [&]() { CastToDlibImg(GetView(frame_img_f), dlib_img); });
+}
+
+void BenchLandmark(BenchReporter& reporter, const std::string& obj_filename,
+                   const std::string& predictor_path) {
+    // Model loading
+    std::shared_ptr<const LandmarkModel> model;
+    reporter.run("LoadLandmarkModel", 0,
+                 [&]() { model = LoadLandmarkModel(predictor_path); });
+
+    // Face image rendered on CPU
+    Renderer renderer(IMG_W, IMG_H, RenderBackend::CPU);
+    renderer.setColorFormat(ColorFormat::RGBA8);
+    renderer.setDenseReadback(false);
+    renderer.loadObj(obj_filename);
+    const FrameView frame = renderer.waitDrawView(
+            renderer.submitDraw(GenMvpMatrix(renderer.getMesh())));
+    dlib::array2d<dlib::rgb_pixel> dlib_img;
+    CastToDlibImg(frame.color, dlib_img);
+
+    // Face detection and shape prediction
+    dlib::frontal_face_detector detector = model->detector;
+    std::vector<dlib::rectangle> face_rects;
+    reporter.run("FaceDetection", IMG_W * IMG_H,
+                 [&]() { face_rects = detector(dlib_img); });
+    if (face_rects.empty()) {
+        Log(LogLevel::WARN, "No face in rendered image, skip prediction");
+        return;
+    }
+    reporter.run("ShapePrediction", model->numParts(),
+                 [&]() { model->predict(dlib_img, face_rects[0]); });
+}
+
+// End-to-end stages over the face (as driven by `main`)
+void BenchPipeline(BenchReporter& reporter, const std::string& obj_filename,
+                   const std::string& predictor_path,
+                   const std::vector<RenderBackend>& backends) {
+    const std::shared_ptr<const LandmarkModel> model =
+            LoadLandmarkModel(predictor_path);
+    const std::vector<std::string> filenames(N_BATCH_MESHES, obj_filename);
+    for (auto&& backend : backends) {
+        const std::string backend_name =
+                (backend == RenderBackend::CPU) ? "Cpu" : "Vulkan";
+        Renderer renderer(IMG_W, IMG_H, backend);
+        renderer.setColorFormat(ColorFormat::RGBA8);
+        renderer.setDenseReadback(false);
+        renderer.loadObj(obj_filename);
+        const std::shared_ptr<const Mesh> mesh = renderer.getMeshPtr();
+        const glm::mat4 mvp_mat = GenMvpMatrix(*mesh);
+
+        // Draw, readback and detection with surface lookup of one frame
+        LandmarkDetector detector(model);
+        reporter.run("Pipeline::detect/" + backend_name, IMG_W * IMG_H, [&]() {
+            const FrameView frame =
+                    renderer.waitDrawView(renderer.submitDraw(mvp_mat));
+            detector.detect(frame, *mesh);
+        });
+
+        // Batch of meshes (loaded through cache) with fused views
+        LandmarkDetectorPool detectors(model);
+        BatchConfig config;
+        config.gen_mvp_mats = [](const Mesh& batch_mesh) {
+            return std::vector<glm::mat4>(N_BATCH_VIEWS,
+                                          GenMvpMatrix(batch_mesh));
+        };
+        reporter.run("RunBatch/" + backend_name, N_BATCH_MESHES, [&]() {
+            RunBatch(filenames, renderer, detectors, config,
+                     [](const BatchResult&) {});
+        });
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+    // Parse arguments
+    std::string output_path = "-";
+    std::string obj_filename = DEFAULT_OBJ;
+    std::string tex_filename = DEFAULT_TEXTURE;
+    std::string predictor_path = DEFAULT_PREDICTOR;
+    uint32_t n_iters = 10;
+    std::vector<RenderBackend> backends = {RenderBackend::CPU};
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--iters" && i + 1 < argc) {
+            n_iters = static_cast<uint32_t>(std::max(std::stoi(argv[++i]), 1));
+        } else if (arg == "--obj" && i + 1 < argc) {
+            obj_filename = argv[++i];
+        } else if (arg == "--texture" && i + 1 < argc) {
+            tex_filename = argv[++i];
+        } else if (arg == "--predictor" && i + 1 < argc) {
+            predictor_path = argv[++i];
+        } else if (arg == "--vulkan") {
+            backends.push_back(RenderBackend::VULKAN);  // Also lavapipe
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--output <file or ->] [--iters <n>] [--obj <obj>]"
+                      << " [--texture <image>] [--predictor <dat>] [--vulkan]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::FILE* fp = (output_path == "-") ? stdout :
+                                           std::fopen(output_path.c_str(), "w");
+    if (!fp) {
+        std::cerr << "Failed to open " << output_path << std::endl;
+        return 1;
+    }
+    BenchReporter reporter(fp, n_iters);
+
+    // Synthetic meshes at scaled sizes
+    const auto dir = std::filesystem::temp_directory_path() / "facelmk3d_bench";
+    std::filesystem::create_directories(dir);
+    for (auto&& n_div : SPHERE_DIVS) {
+        BenchMesh(reporter, WriteSphereObj(dir, n_div),
+                  "/sphere" + std::to_string(n_div), backends);
+    }
+
+    // Real data (skipped when missing)
+    if (std::filesystem::exists(tex_filename)) {
+        BenchImage(reporter, tex_filename);
+    } else {
+        Log(LogLevel::WARN, "Skip image benchmarks: ", tex_filename);
+    }
+    if (std::filesystem::exists(obj_filename)) {
+        BenchMesh(reporter, obj_filename, "/face", backends);
+        if (std::filesystem::exists(predictor_path)) {
+            BenchLandmark(reporter, obj_filename, predictor_path);
+            BenchPipeline(reporter, obj_filename, predictor_path, backends);
+        } else {
+            Log(LogLevel::WARN, "Skip landmark benchmarks: ", predictor_path);
+        }
+    } else {
+        Log(LogLevel::WARN, "Skip face benchmarks: ", obj_filename);
+    }
+
+    if (fp != stdout) {
+        std::fclose(fp);
+    }
+    return 0;
+}
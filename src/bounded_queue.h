@@ -0,0 +1,73 @@
+#ifndef BOUNDED_QUEUE_H_20210218
+#define BOUNDED_QUEUE_H_20210218
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// -----------------------------------------------------------------------------
+// -------------------------------- Bounded Queue ------------------------------
+// -----------------------------------------------------------------------------
+// Blocking queue between pipeline stages. Producers wait while it is full, so
+// items in flight (and their memory) are capped by the capacity.
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity) : m_capacity(capacity < 1 ? 1 : capacity) {}
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Waits while full. Returns false when closed (the item is dropped).
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [&]() {
+            return m_closed || m_items.size() < m_capacity;
+        });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        lock.unlock();
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    // Waits while empty. Returns false when closed and drained.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [&]() { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    // Stops accepting items. Remaining ones can still be popped.
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_not_full.notify_all();
+        m_not_empty.notify_all();
+    }
+
+private:
+    const size_t m_capacity;
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+    bool m_closed = false;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
@@ -0,0 +1,187 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const uint32_t LEAF_SIZE = 4;    // Maximum triangles in a leaf
+const uint32_t MAX_DEPTH = 64;   // Traversal stack size
+const float PARALLEL_EPS = 1e-12f;
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+bool IntersectBox(const glm::vec3& min_pos, const glm::vec3& max_pos,
+                  const glm::vec3& orig, const glm::vec3& inv_dir,
+                  float t_max) {
+    const glm::vec3 t0 = (min_pos - orig) * inv_dir;
+    const glm::vec3 t1 = (max_pos - orig) * inv_dir;
+    const glm::vec3 t_near = glm::min(t0, t1);
+    const glm::vec3 t_far = glm::max(t0, t1);
+    const float enter = std::max(std::max(t_near.x, t_near.y),
+                                 std::max(t_near.z, 0.f));
+    const float exit = std::min(std::min(t_far.x, t_far.y),
+                                std::min(t_far.z, t_max));
+    return enter <= exit;
+}
+
+// Moller-Trumbore intersection (returns false for miss)
+bool IntersectTriangle(const glm::vec3& p0, const glm::vec3& p1,
+                       const glm::vec3& p2, const glm::vec3& orig,
+                       const glm::vec3& dir, float& t, float& u, float& v) {
+    const glm::vec3 e1 = p1 - p0;
+    const glm::vec3 e2 = p2 - p0;
+    const glm::vec3 p = glm::cross(dir, e2);
+    const float det = glm::dot(e1, p);
+    if (std::abs(det) < PARALLEL_EPS) {
+        return false;
+    }
+    const float inv_det = 1.f / det;
+    const glm::vec3 s = orig - p0;
+    u = glm::dot(s, p) * inv_det;
+    if (u < 0.f || 1.f < u) {
+        return false;
+    }
+    const glm::vec3 q = glm::cross(s, e1);
+    v = glm::dot(dir, q) * inv_det;
+    if (v < 0.f || 1.f < u + v) {
+        return false;
+    }
+    t = glm::dot(e2, q) * inv_det;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ------------------------ Bounding Volume Hierarchy --------------------------
+// -----------------------------------------------------------------------------
+void Bvh::build(const std::vector<glm::vec3>& points,
+                const std::vector<uint32_t>& indices) {
+    if (indices.size() % 3 != 0) {
+        throw std::runtime_error("Bvh: Indices are not a triangle list");
+    }
+    m_points = points;
+    m_indices = indices;
+    m_nodes.clear();
+
+    // Triangle centers to split
+    const uint32_t n_tris = static_cast<uint32_t>(m_indices.size() / 3);
+    std::vector<glm::vec3> centers(n_tris);
+    for (uint32_t tri_idx = 0; tri_idx < n_tris; tri_idx++) {
+        centers[tri_idx] = (m_points[m_indices[tri_idx * 3 + 0]] +
+                            m_points[m_indices[tri_idx * 3 + 1]] +
+                            m_points[m_indices[tri_idx * 3 + 2]]) /
+                           3.f;
+    }
+    m_tri_idxs.resize(n_tris);
+    std::iota(m_tri_idxs.begin(), m_tri_idxs.end(), 0);
+
+    if (0 < n_tris) {
+        m_nodes.reserve(n_tris / LEAF_SIZE * 2 + 1);
+        buildNode(0, n_tris, centers);
+    }
+}
+
+bool Bvh::empty() const {
+    return m_nodes.empty();
+}
+
+Bvh::Hit Bvh::intersect(const glm::vec3& orig, const glm::vec3& dir,
+                        float t_max) const {
+    Hit hit;
+    if (m_nodes.empty()) {
+        return hit;
+    }
+    hit.t = t_max;
+    const glm::vec3 inv_dir = 1.f / dir;  // Infinity is handled by slab test
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t n_stack = 0;
+    stack[n_stack++] = 0;
+    while (0 < n_stack) {
+        const Node& node = m_nodes[stack[--n_stack]];
+        if (!IntersectBox(node.min_pos, node.max_pos, orig, inv_dir, hit.t)) {
+            continue;
+        }
+        if (node.left == 0) {
+            // Leaf
+            for (uint32_t i = node.begin; i < node.end; i++) {
+                const uint32_t tri_idx = m_tri_idxs[i];
+                const uint32_t* idxs = &m_indices[tri_idx * 3];
+                float t, u, v;
+                if (IntersectTriangle(m_points[idxs[0]], m_points[idxs[1]],
+                                      m_points[idxs[2]], orig, dir, t, u,
+                                      v) &&
+                    0.f <= t && t <= hit.t) {
+                    hit.t = t;
+                    hit.tri_idx = tri_idx;
+                    hit.bary = {1.f - u - v, u, v};
+                }
+            }
+            continue;
+        }
+        if (n_stack + 2 > MAX_DEPTH) {
+            throw std::runtime_error("Bvh: Too deep hierarchy");
+        }
+        stack[n_stack++] = node.right;
+        stack[n_stack++] = node.left;
+    }
+    return hit;
+}
+
+uint32_t Bvh::buildNode(uint32_t begin, uint32_t end,
+                        const std::vector<glm::vec3>& centers) {
+    // Bounding box of the triangles and their centers
+    glm::vec3 min_pos(std::numeric_limits<float>::max());
+    glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+    glm::vec3 min_center = min_pos, max_center = max_pos;
+    for (uint32_t i = begin; i < end; i++) {
+        const uint32_t tri_idx = m_tri_idxs[i];
+        for (uint32_t k = 0; k < 3; k++) {
+            const glm::vec3& p = m_points[m_indices[tri_idx * 3 + k]];
+            min_pos = glm::min(min_pos, p);
+            max_pos = glm::max(max_pos, p);
+        }
+        min_center = glm::min(min_center, centers[tri_idx]);
+        max_center = glm::max(max_center, centers[tri_idx]);
+    }
+
+    const uint32_t node_idx = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({min_pos, max_pos, begin, end, 0, 0});
+    if (end - begin <= LEAF_SIZE) {
+        return node_idx;  // Leaf
+    }
+
+    // Split at the median center along the longest axis (balanced, so the
+    // depth is bounded by log2 of the triangle count)
+    const glm::vec3 extent = max_center - min_center;
+    int axis = 0;
+    if (extent[axis] < extent.y) axis = 1;
+    if (extent[axis] < extent.z) axis = 2;
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(m_tri_idxs.begin() + begin, m_tri_idxs.begin() + mid,
+                     m_tri_idxs.begin() + end, [&](uint32_t a, uint32_t b) {
+                         return centers[a][axis] < centers[b][axis];
+                     });
+
+    // Build children (`m_nodes` may be reallocated)
+    const uint32_t left = buildNode(begin, mid, centers);
+    const uint32_t right = buildNode(mid, end, centers);
+    m_nodes[node_idx].left = left;
+    m_nodes[node_idx].right = right;
+    return node_idx;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
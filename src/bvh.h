@@ -0,0 +1,55 @@
+#ifndef BVH_H_20210215
+#define BVH_H_20210215
+#include <vkw/warning_suppressor.h>
+
+#include <cstdint>
+#include <vector>
+
+BEGIN_VKW_SUPPRESS_WARNING
+#include <glm/glm.hpp>
+END_VKW_SUPPRESS_WARNING
+
+// -----------------------------------------------------------------------------
+// ------------------------ Bounding Volume Hierarchy --------------------------
+// -----------------------------------------------------------------------------
+// Ray casting against a triangle list.
+class Bvh {
+public:
+    static constexpr uint32_t INVALID_ID = uint32_t(~0);
+
+    struct Hit {
+        float t = 0.f;                  // Ray parameter (`orig + t * dir`)
+        uint32_t tri_idx = INVALID_ID;  // Triangle index in the list
+        glm::vec3 bary{0.f};            // Barycentric coordinate
+    };
+
+    void build(const std::vector<glm::vec3>& points,
+               const std::vector<uint32_t>& indices);
+    bool empty() const;
+
+    // Returns the nearest hit in `[0, t_max]` (`tri_idx` is `INVALID_ID` for
+    // miss). Both faces are hit, as culling is disabled in the renderers.
+    Hit intersect(const glm::vec3& orig, const glm::vec3& dir,
+                  float t_max) const;
+
+private:
+    struct Node {
+        glm::vec3 min_pos, max_pos;
+        uint32_t begin, end;   // Range in `m_tri_idxs`
+        uint32_t left, right;  // Child node indices (0 for leaf)
+    };
+
+    uint32_t buildNode(uint32_t begin, uint32_t end,
+                       const std::vector<glm::vec3>& centers);
+
+    std::vector<glm::vec3> m_points;
+    std::vector<uint32_t> m_indices;
+    std::vector<uint32_t> m_tri_idxs;  // Reordered triangle indices
+    std::vector<Node> m_nodes;         // Root is the first one
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
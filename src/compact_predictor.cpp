@@ -0,0 +1,389 @@
+#include "compact_predictor.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__F16C__)
+#define COMPACT_PREDICTOR_USE_F16C
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const char MAGIC[8] = {'F', 'L', 'M', 'K', 'S', 'P', '0', '1'};
+const uint32_t VERSION = 1;
+const uint64_t ALIGNMENT = 64;  // Alignment of arrays in the file
+const uint32_t MAX_FEATURES = 1 << 16;  // Split features are 16-bit
+
+// -----------------------------------------------------------------------------
+// ------------------------------- File Structure ------------------------------
+// -----------------------------------------------------------------------------
+struct PredictorHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t use_f16;
+    uint32_t n_parts, n_cascades, n_trees, n_splits, n_features;
+    uint32_t reserved;
+    uint64_t initial_shape_offset, anchors_offset, deltas_offset;
+    uint64_t splits_offset, thresholds_offset, leaves_offset;
+    uint64_t file_size;
+};
+
+inline uint64_t AlignUp(uint64_t v) {
+    return (v + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Fills offsets from counts
+void LayoutFile(PredictorHeader& header) {
+    const uint64_t value_bytes = header.use_f16 ? 2 : 4;
+    const uint64_t n_coords = uint64_t(header.n_parts) * 2;
+    const uint64_t n_feats = uint64_t(header.n_cascades) * header.n_features;
+    const uint64_t n_trees = uint64_t(header.n_cascades) * header.n_trees;
+    header.initial_shape_offset = AlignUp(sizeof(PredictorHeader));
+    header.anchors_offset =
+            AlignUp(header.initial_shape_offset + n_coords * sizeof(float));
+    header.deltas_offset =
+            AlignUp(header.anchors_offset + n_feats * sizeof(uint32_t));
+    header.splits_offset =
+            AlignUp(header.deltas_offset + n_feats * 2 * sizeof(float));
+    header.thresholds_offset = AlignUp(
+            header.splits_offset +
+            n_trees * header.n_splits * 2 * sizeof(uint16_t));
+    header.leaves_offset = AlignUp(header.thresholds_offset +
+                                   n_trees * header.n_splits * value_bytes);
+    header.file_size =
+            header.leaves_offset +
+            n_trees * (header.n_splits + 1) * n_coords * value_bytes;
+}
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- Float16 ----------------------------------
+// -----------------------------------------------------------------------------
+// IEEE half precision (rounded to nearest even)
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t f_exp = (bits >> 23) & 0xff;
+    uint32_t mant = bits & 0x7fffff;
+    if (f_exp == 0xff) {
+        return uint16_t(sign | 0x7c00 | (mant ? 0x200 : 0));  // Inf or NaN
+    }
+    const int32_t exp = int32_t(f_exp) - 127 + 15;
+    if (0x1f <= exp) {
+        return uint16_t(sign | 0x7c00);  // Overflow
+    }
+    if (exp <= 0) {
+        // Subnormal
+        if (exp < -10) {
+            return uint16_t(sign);
+        }
+        mant |= 0x800000;
+        const uint32_t shift = uint32_t(14 - exp);
+        uint32_t half = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (halfway < rem || (rem == halfway && (half & 1))) {
+            half++;
+        }
+        return uint16_t(sign | half);
+    }
+    uint32_t half = (uint32_t(exp) << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fff;
+    if (0x1000 < rem || (rem == 0x1000 && (half & 1))) {
+        half++;  // May carry into exponent
+    }
+    return uint16_t(sign | half);
+}
+
+inline float HalfToFloat(uint16_t half) {
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    uint32_t exp = (half >> 10) & 0x1f;
+    uint32_t mant = half & 0x3ff;
+    uint32_t bits;
+    if (exp == 0x1f) {
+        bits = sign | 0x7f800000 | (mant << 13);  // Inf or NaN
+    } else if (exp != 0) {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;  // Zero
+    } else {
+        // Subnormal (normalized for float)
+        exp = 127 - 15 + 1;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// -------------------------- Compact Shape Predictor --------------------------
+// -----------------------------------------------------------------------------
+void ConvertShapePredictor(const std::string& dlib_path,
+                           const std::string& compact_path, bool use_f16) {
+    // Read members in the order of `dlib::serialize(shape_predictor)`
+    std::ifstream ifs(dlib_path, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error("Failed to open " + dlib_path);
+    }
+    int version = 0;
+    dlib::matrix<float, 0, 1> initial_shape;
+    std::vector<std::vector<dlib::impl::regression_tree>> forests;
+    std::vector<std::vector<unsigned long>> anchor_idxs;
+    std::vector<std::vector<dlib::vector<float, 2>>> deltas;
+    dlib::deserialize(version, ifs);
+    if (version != 1) {
+        throw std::runtime_error("Unknown shape predictor version");
+    }
+    dlib::deserialize(initial_shape, ifs);
+    dlib::deserialize(forests, ifs);
+    dlib::deserialize(anchor_idxs, ifs);
+    dlib::deserialize(deltas, ifs);
+
+    // Check uniform sizes
+    PredictorHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.use_f16 = use_f16 ? 1 : 0;
+    header.n_parts = static_cast<uint32_t>(initial_shape.size() / 2);
+    header.n_cascades = static_cast<uint32_t>(forests.size());
+    if (forests.empty() || forests[0].empty() || anchor_idxs.empty()) {
+        throw std::runtime_error("Empty shape predictor");
+    }
+    header.n_trees = static_cast<uint32_t>(forests[0].size());
+    header.n_splits = static_cast<uint32_t>(forests[0][0].splits.size());
+    header.n_features = static_cast<uint32_t>(anchor_idxs[0].size());
+    if (MAX_FEATURES < header.n_features ||
+        anchor_idxs.size() != forests.size() ||
+        deltas.size() != forests.size()) {
+        throw std::runtime_error("Unsupported shape predictor layout");
+    }
+    const uint32_t n_coords = header.n_parts * 2;
+    for (size_t c = 0; c < forests.size(); c++) {
+        if (forests[c].size() != header.n_trees ||
+            anchor_idxs[c].size() != header.n_features ||
+            deltas[c].size() != header.n_features) {
+            throw std::runtime_error("Cascades differ in size");
+        }
+        for (auto&& tree : forests[c]) {
+            if (tree.splits.size() != header.n_splits ||
+                tree.leaf_values.size() != header.n_splits + 1) {
+                throw std::runtime_error("Trees differ in depth");
+            }
+            for (auto&& leaf : tree.leaf_values) {
+                if (leaf.size() != n_coords) {
+                    throw std::runtime_error("Invalid leaf size");
+                }
+            }
+        }
+    }
+    LayoutFile(header);
+
+    // Flatten arrays
+    std::vector<float> shape_vals(initial_shape.begin(), initial_shape.end());
+    std::vector<uint32_t> anchor_vals;
+    std::vector<float> delta_vals;
+    for (size_t c = 0; c < forests.size(); c++) {
+        for (uint32_t i = 0; i < header.n_features; i++) {
+            anchor_vals.push_back(static_cast<uint32_t>(anchor_idxs[c][i]));
+            delta_vals.push_back(deltas[c][i].x());
+            delta_vals.push_back(deltas[c][i].y());
+        }
+    }
+    std::vector<uint16_t> split_vals;
+    std::vector<float> thresh_vals, leaf_vals;
+    for (auto&& forest : forests) {
+        for (auto&& tree : forest) {
+            for (auto&& split : tree.splits) {
+                split_vals.push_back(static_cast<uint16_t>(split.idx1));
+                split_vals.push_back(static_cast<uint16_t>(split.idx2));
+                thresh_vals.push_back(split.thresh);
+            }
+            for (auto&& leaf : tree.leaf_values) {
+                leaf_vals.insert(leaf_vals.end(), leaf.begin(), leaf.end());
+            }
+        }
+    }
+
+    // Write to temporary file, then replace (readers never see half files)
+    const std::string tmp_path = GetTempFilename(compact_path);
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs) {
+            throw std::runtime_error("Failed to open " + tmp_path);
+        }
+        auto write_at = [&](uint64_t offset, const void* data, uint64_t n) {
+            ofs.seekp(static_cast<std::streamoff>(offset));
+            ofs.write(static_cast<const char*>(data),
+                      static_cast<std::streamsize>(n));
+        };
+        auto write_values = [&](uint64_t offset,
+                                const std::vector<float>& vals) {
+            if (!use_f16) {
+                write_at(offset, vals.data(), vals.size() * sizeof(float));
+                return;
+            }
+            std::vector<uint16_t> halfs(vals.size());
+            for (size_t i = 0; i < vals.size(); i++) {
+                halfs[i] = FloatToHalf(vals[i]);
+            }
+            write_at(offset, halfs.data(), halfs.size() * sizeof(uint16_t));
+        };
+        write_at(0, &header, sizeof(PredictorHeader));
+        write_at(header.initial_shape_offset, shape_vals.data(),
+                 shape_vals.size() * sizeof(float));
+        write_at(header.anchors_offset, anchor_vals.data(),
+                 anchor_vals.size() * sizeof(uint32_t));
+        write_at(header.deltas_offset, delta_vals.data(),
+                 delta_vals.size() * sizeof(float));
+        write_at(header.splits_offset, split_vals.data(),
+                 split_vals.size() * sizeof(uint16_t));
+        write_values(header.thresholds_offset, thresh_vals);
+        write_values(header.leaves_offset, leaf_vals);
+        if (!ofs) {
+            throw std::runtime_error("Failed to write " + tmp_path);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, compact_path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_path, ec);
+        throw std::runtime_error("Failed to replace " + compact_path);
+    }
+}
+
+bool IsCompactShapePredictor(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(MAGIC)] = {};
+    ifs.read(magic, sizeof(magic));
+    return ifs && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void CompactShapePredictor::open(const std::string& path) {
+    // Map whole file
+    auto file = MappedFile::Open(path);
+    if (!file || file->size() < sizeof(PredictorHeader)) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    PredictorHeader header;
+    std::memcpy(&header, file->data(), sizeof(PredictorHeader));
+
+    // Check format (offsets are recomputed from counts)
+    PredictorHeader expected = header;
+    LayoutFile(expected);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || MAX_FEATURES < header.n_features ||
+        std::memcmp(&header, &expected, sizeof(PredictorHeader)) != 0 ||
+        header.file_size != file->size()) {
+        throw std::runtime_error("Broken shape predictor: " + path);
+    }
+    const uint8_t* data = file->data();
+    const auto anchor_idxs =
+            reinterpret_cast<const uint32_t*>(data + header.anchors_offset);
+    const size_t n_feats = size_t(header.n_cascades) * header.n_features;
+    for (size_t i = 0; i < n_feats; i++) {
+        if (header.n_parts <= anchor_idxs[i]) {
+            throw std::runtime_error("Broken shape predictor: " + path);
+        }
+    }
+    // Split features index sampled pixels of the cascade
+    const auto split_idxs =
+            reinterpret_cast<const uint16_t*>(data + header.splits_offset);
+    const size_t n_split_idxs = size_t(header.n_cascades) * header.n_trees *
+                                header.n_splits * 2;
+    for (size_t i = 0; i < n_split_idxs; i++) {
+        if (header.n_features <= split_idxs[i]) {
+            throw std::runtime_error("Broken shape predictor: " + path);
+        }
+    }
+
+    m_use_f16 = (header.use_f16 != 0);
+    m_n_parts = header.n_parts;
+    m_n_cascades = header.n_cascades;
+    m_n_trees = header.n_trees;
+    m_n_splits = header.n_splits;
+    m_n_features = header.n_features;
+    const auto shape_ptr =
+            reinterpret_cast<const float*>(data + header.initial_shape_offset);
+    m_initial_shape.set_size(m_n_parts * 2);
+    std::copy(shape_ptr, shape_ptr + m_n_parts * 2, m_initial_shape.begin());
+    m_anchor_idxs = anchor_idxs;
+    m_deltas = reinterpret_cast<const float*>(data + header.deltas_offset);
+    m_split_idxs = split_idxs;
+    m_thresholds = data + header.thresholds_offset;
+    m_leaves = data + header.leaves_offset;
+    m_file = std::move(file);
+}
+
+bool CompactShapePredictor::empty() const {
+    return !m_file;
+}
+
+unsigned long CompactShapePredictor::num_parts() const {
+    return m_n_parts;
+}
+
+uint32_t CompactShapePredictor::findLeaf(size_t tree_idx,
+                                         const float* pixel_values) const {
+    // Complete binary tree (children of `i` are `2i + 1` and `2i + 2`)
+    const uint16_t* split_idxs = &m_split_idxs[tree_idx * m_n_splits * 2];
+    const size_t thresh_offset = tree_idx * m_n_splits;
+    uint32_t i = 0;
+    while (i < m_n_splits) {
+        const float diff = pixel_values[split_idxs[i * 2]] -
+                           pixel_values[split_idxs[i * 2 + 1]];
+        const float thresh =
+                m_use_f16 ? HalfToFloat(static_cast<const uint16_t*>(
+                                    m_thresholds)[thresh_offset + i]) :
+                            static_cast<const float*>(
+                                    m_thresholds)[thresh_offset + i];
+        i = (thresh < diff) ? (2 * i + 1) : (2 * i + 2);
+    }
+    return i - m_n_splits;
+}
+
+void CompactShapePredictor::addLeaf(size_t leaf_idx, float* shape) const {
+    const uint32_t n_coords = m_n_parts * 2;
+    if (!m_use_f16) {
+        const float* leaf =
+                &static_cast<const float*>(m_leaves)[leaf_idx * n_coords];
+        for (uint32_t i = 0; i < n_coords; i++) {
+            shape[i] += leaf[i];
+        }
+        return;
+    }
+
+    const uint16_t* leaf =
+            &static_cast<const uint16_t*>(m_leaves)[leaf_idx * n_coords];
+    uint32_t i = 0;
+#ifdef COMPACT_PREDICTOR_USE_F16C
+    for (; i + 8 <= n_coords; i += 8) {
+        const __m128i halfs =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(leaf + i));
+        _mm256_storeu_ps(shape + i, _mm256_add_ps(_mm256_loadu_ps(shape + i),
+                                                  _mm256_cvtph_ps(halfs)));
+    }
+#endif
+    for (; i < n_coords; i++) {
+        shape[i] += HalfToFloat(leaf[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
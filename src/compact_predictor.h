@@ -0,0 +1,126 @@
+#ifndef COMPACT_PREDICTOR_H_20210224
+#define COMPACT_PREDICTOR_H_20210224
+
+#include <vkw/warning_suppressor.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+BEGIN_VKW_SUPPRESS_WARNING
+#include <dlib/image_processing/shape_predictor.h>
+END_VKW_SUPPRESS_WARNING
+
+// -----------------------------------------------------------------------------
+// -------------------------- Compact Shape Predictor --------------------------
+// -----------------------------------------------------------------------------
+// Flat layout of dlib's shape predictor, memory-mapped instead of parsed.
+// Pages are shared between processes, and loading takes only the mapping.
+// With float16, split thresholds and leaf values are stored at half size.
+//
+// File layout (native byte order, arrays aligned to 64 bytes):
+//   header (magic "FLMKSP01"), initial shape float[n_parts * 2],
+//   anchor indices uint32[n_cascades][n_features],
+//   deltas float[n_cascades][n_features][2],
+//   split features uint16[n_cascades][n_trees][n_splits][2],
+//   thresholds float/half[n_cascades][n_trees][n_splits],
+//   leaf values float/half[n_cascades][n_trees][n_splits + 1][n_parts * 2]
+
+// Converts a dlib predictor file (trees must have the same depth)
+void ConvertShapePredictor(const std::string& dlib_path,
+                           const std::string& compact_path, bool use_f16);
+
+// Checks the magic of the file
+bool IsCompactShapePredictor(const std::string& path);
+
+// Same results as `dlib::shape_predictor` (except float16 rounding).
+// Copies share the mapping, and prediction is thread-safe.
+class CompactShapePredictor {
+public:
+    // Maps the file (throws for missing or broken files)
+    void open(const std::string& path);
+    bool empty() const;
+    unsigned long num_parts() const;
+
+    template <typename ImgType>
+    dlib::full_object_detection operator()(const ImgType& img,
+                                           const dlib::rectangle& rect) const;
+
+private:
+    // Leaf index of a tree by its splits
+    uint32_t findLeaf(size_t tree_idx, const float* pixel_values) const;
+    // Adds leaf values to the shape
+    void addLeaf(size_t leaf_idx, float* shape) const;
+
+    std::shared_ptr<MappedFile> m_file;
+    bool m_use_f16 = false;
+    uint32_t m_n_parts = 0;
+    uint32_t m_n_cascades = 0;
+    uint32_t m_n_trees = 0;  // For each cascade
+    uint32_t m_n_splits = 0;  // For each tree
+    uint32_t m_n_features = 0;  // Sampled pixels for each cascade
+    dlib::matrix<float, 0, 1> m_initial_shape;
+    const uint32_t* m_anchor_idxs = nullptr;
+    const float* m_deltas = nullptr;
+    const uint16_t* m_split_idxs = nullptr;
+    const void* m_thresholds = nullptr;  // float or half
+    const void* m_leaves = nullptr;      // float or half
+};
+
+// -----------------------------------------------------------------------------
+// --------------------------- Template Implementation -------------------------
+// -----------------------------------------------------------------------------
+template <typename ImgType>
+dlib::full_object_detection CompactShapePredictor::operator()(
+        const ImgType& img, const dlib::rectangle& rect) const {
+    namespace impl = dlib::impl;
+    const dlib::point_transform_affine tform_to_img =
+            impl::unnormalizing_tform(rect);
+    const dlib::rectangle area = dlib::get_rect(img);
+    const dlib::const_image_view<ImgType> img_view(img);
+
+    // Cascade of forests (same as `dlib::shape_predictor::operator()`)
+    dlib::matrix<float, 0, 1> shape = m_initial_shape;
+    std::vector<float> pixel_values(m_n_features);
+    for (uint32_t cascade_idx = 0; cascade_idx < m_n_cascades; cascade_idx++) {
+        // Sample pixels relative to the current shape
+        const dlib::matrix<float, 2, 2> tform = dlib::matrix_cast<float>(
+                impl::find_tform_between_shapes(m_initial_shape, shape)
+                        .get_m());
+        const size_t feat_offset = size_t(cascade_idx) * m_n_features;
+        for (uint32_t i = 0; i < m_n_features; i++) {
+            const float* delta = &m_deltas[(feat_offset + i) * 2];
+            const dlib::vector<float, 2> delta_vec(delta[0], delta[1]);
+            const dlib::point p = tform_to_img(
+                    tform * delta_vec +
+                    impl::location(shape, m_anchor_idxs[feat_offset + i]));
+            pixel_values[i] =
+                    area.contains(p) ?
+                            float(dlib::get_pixel_intensity(
+                                    img_view[p.y()][p.x()])) :
+                            0.f;
+        }
+
+        // Accumulate leaves of trees
+        for (uint32_t tree = 0; tree < m_n_trees; tree++) {
+            const size_t tree_idx = size_t(cascade_idx) * m_n_trees + tree;
+            const uint32_t leaf = findLeaf(tree_idx, pixel_values.data());
+            addLeaf(tree_idx * (m_n_splits + 1) + leaf, &shape(0));
+        }
+    }
+
+    // To image coordinates
+    std::vector<dlib::point> parts(m_n_parts);
+    for (uint32_t i = 0; i < m_n_parts; i++) {
+        parts[i] = tform_to_img(impl::location(shape, i));
+    }
+    return dlib::full_object_detection(rect, parts);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "compact_predictor.h"
+#include "image.h"
+#include "landmarker.h"
+#include "log.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const long NOISE_SIZE = 256;     // Synthetic image for the comparison
+const long NOISE_RECT_STEP = 32;  // Grid of face rectangles on the noise
+const long NOISE_RECT_SIZE = 96;
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+template <typename Func>
+double MeasureMs(Func&& func) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Deviation of landmarks between predictors [px]
+struct Deviation {
+    size_t n_points = 0;
+    double sum_px = 0.0;
+    double max_px = 0.0;
+
+    void add(const dlib::full_object_detection& a,
+             const dlib::full_object_detection& b) {
+        for (unsigned long i = 0; i < a.num_parts(); i++) {
+            const double d = dlib::length(a.part(i) - b.part(i));
+            sum_px += d;
+            max_px = std::max(max_px, d);
+            n_points++;
+        }
+    }
+
+    double mean() const {
+        return n_points ? sum_px / static_cast<double>(n_points) : 0.0;
+    }
+};
+
+void PrintUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <dlib predictor .dat> <output> [--f16]"
+              << " [--check <image>]... [--tol <px>] [--max-tol <px>]"
+              << std::endl;
+}
+
+void Compare(const dlib::shape_predictor& dlib_predictor,
+             const CompactShapePredictor& compact_predictor,
+             const dlib::array2d<dlib::rgb_pixel>& img,
+             const std::vector<dlib::rectangle>& rects, Deviation& dev) {
+    for (auto&& rect : rects) {
+        dev.add(dlib_predictor(img, rect), compact_predictor(img, rect));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+    // Parse arguments
+    std::vector<std::string> paths, check_filenames;
+    bool use_f16 = false;
+    double tolerance_px = 0.5;      // Mean deviation
+    double max_tolerance_px = 2.0;  // Deviation of any single point
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg == "--f16") {
+                use_f16 = true;
+            } else if (arg == "--check" && i + 1 < argc) {
+                check_filenames.push_back(argv[++i]);
+            } else if (arg == "--tol" && i + 1 < argc) {
+                tolerance_px = std::stod(argv[++i]);
+            } else if (arg == "--max-tol" && i + 1 < argc) {
+                max_tolerance_px = std::stod(argv[++i]);
+            } else {
+                paths.push_back(arg);
+            }
+        } catch (const std::exception& e) {
+            // Invalid option values
+            std::cerr << e.what() << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (paths.size() != 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    const std::string& dlib_path = paths[0];
+    const std::string& compact_path = paths[1];
+
+    // Converted and checked under a temporary name, so out-of-tolerance
+    // predictors never appear at the output
+    const std::string tmp_path = GetTempFilename(compact_path);
+    std::error_code ec;
+    try {
+        ConvertShapePredictor(dlib_path, tmp_path, use_f16);
+
+        // Loading times
+        dlib::shape_predictor dlib_predictor;
+        CompactShapePredictor compact_predictor;
+        const double dlib_load_ms = MeasureMs(
+                [&]() { dlib::deserialize(dlib_path) >> dlib_predictor; });
+        const double compact_load_ms =
+                MeasureMs([&]() { compact_predictor.open(tmp_path); });
+
+        // Deterministic noise with a grid of rectangles
+        Deviation dev;
+        dlib::array2d<dlib::rgb_pixel> dlib_img(NOISE_SIZE, NOISE_SIZE);
+        std::mt19937 engine(0);
+        std::uniform_int_distribution<int> dist(0, 255);
+        for (long y = 0; y < NOISE_SIZE; y++) {
+            for (long x = 0; x < NOISE_SIZE; x++) {
+                const auto v = static_cast<unsigned char>(dist(engine));
+                dlib_img[y][x] = dlib::rgb_pixel(v, v, v);
+            }
+        }
+        std::vector<dlib::rectangle> rects;
+        for (long y = 0; y + NOISE_RECT_SIZE <= NOISE_SIZE;
+             y += NOISE_RECT_STEP) {
+            for (long x = 0; x + NOISE_RECT_SIZE <= NOISE_SIZE;
+                 x += NOISE_RECT_STEP) {
+                rects.emplace_back(x, y, x + NOISE_RECT_SIZE - 1,
+                                   y + NOISE_RECT_SIZE - 1);
+            }
+        }
+        Compare(dlib_predictor, compact_predictor, dlib_img, rects, dev);
+
+        // Detected faces in given images
+        dlib::frontal_face_detector detector =
+                dlib::get_frontal_face_detector();
+        size_t n_faces = 0;
+        for (auto&& filename : check_filenames) {
+            const ByteImage img = LoadImage(filename);
+            CastToDlibImg(GetView(img), dlib_img);
+            const std::vector<dlib::rectangle> face_rects = detector(dlib_img);
+            if (face_rects.empty()) {
+                Log(LogLevel::WARN, "No face in ", filename);
+            }
+            n_faces += face_rects.size();
+            Compare(dlib_predictor, compact_predictor, dlib_img, face_rects,
+                    dev);
+        }
+
+        std::printf("{\"f16\":%s,\"dlib_load_ms\":%.3f,"
+                    "\"compact_load_ms\":%.3f,\"n_rects\":%zu,\"n_faces\":%zu,"
+                    "\"mean_px\":%.6f,\"max_px\":%.6f}\n",
+                    use_f16 ? "true" : "false", dlib_load_ms, compact_load_ms,
+                    rects.size(), n_faces, dev.mean(), dev.max_px);
+        if (tolerance_px < dev.mean()) {
+            throw std::runtime_error("Landmarks deviate from dlib by " +
+                                     std::to_string(dev.mean()) +
+                                     " px on average");
+        }
+        if (max_tolerance_px < dev.max_px) {
+            throw std::runtime_error("Landmarks deviate from dlib by up to " +
+                                     std::to_string(dev.max_px) + " px");
+        }
+    } catch (const std::exception& e) {
+        Log(LogLevel::ERROR, e.what());
+        std::filesystem::remove(tmp_path, ec);
+        return 1;
+    }
+
+    std::filesystem::rename(tmp_path, compact_path, ec);
+    if (ec) {
+        Log(LogLevel::ERROR, "Failed to replace ", compact_path, ": ",
+            ec.message());
+        std::filesystem::remove(tmp_path, ec);
+        return 1;
+    }
+    return 0;
+}
@@ -7,18 +7,47 @@
 #include <vector>
 
 // -----------------------------------------------------------------------------
-// -------------------------------- Float Image --------------------------------
+// ----------------------------------- Image -----------------------------------
 // -----------------------------------------------------------------------------
-struct FloatImage {
-    std::vector<float> pixels;
+template <typename T>
+struct Image {
+    std::vector<T> pixels;
     uint32_t width = 0;
     uint32_t height = 0;
     uint32_t n_ch = 0;
 };
 
+using FloatImage = Image<float>;   // [0, 1] for colors
+using ByteImage = Image<uint8_t>;  // 8-bit colors as stored in files
+
 FloatImage CreateImage(uint32_t width, uint32_t height, uint32_t n_ch);
 
-FloatImage LoadImage(const std::string& filename, uint32_t n_ch = 4);
+// Loads 8-bit image (no conversion)
+ByteImage LoadImage(const std::string& filename, uint32_t n_ch = 4);
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Image View --------------------------------
+// -----------------------------------------------------------------------------
+// Non-owning view to packed pixels (valid while the owner keeps them)
+template <typename T>
+struct ImageView {
+    const T* pixels = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t n_ch = 0;
+
+    bool empty() const {
+        return pixels == nullptr;
+    }
+};
+
+using FloatImageView = ImageView<float>;
+using ByteImageView = ImageView<uint8_t>;
+
+template <typename T>
+ImageView<T> GetView(const Image<T>& img) {
+    return {img.pixels.data(), img.width, img.height, img.n_ch};
+}
 
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+#include "kdtree.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "thread_pool.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const uint32_t LEAF_SIZE = 8;       // Maximum points in a leaf
+const uint32_t QUERY_CHUNK = 32;    // Queries per parallel task
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+inline float Distance2(const glm::vec3& a, const glm::vec3& b) {
+    const glm::vec3 d = a - b;
+    return glm::dot(d, d);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- KD-Tree ----------------------------------
+// -----------------------------------------------------------------------------
+void KdTree::build(const std::vector<glm::vec3>& points,
+                   const std::vector<uint32_t>& ids) {
+    if (points.size() != ids.size()) {
+        throw std::runtime_error("KdTree: Points and IDs size mismatch");
+    }
+    m_points = points;
+    m_ids = ids;
+    m_nodes.clear();
+    if (!m_points.empty()) {
+        m_nodes.reserve(m_points.size() / LEAF_SIZE * 2 + 1);
+        buildNode(0, static_cast<uint32_t>(m_points.size()));
+    }
+}
+
+bool KdTree::empty() const {
+    return m_points.empty();
+}
+
+size_t KdTree::size() const {
+    return m_points.size();
+}
+
+uint32_t KdTree::findNearest(const glm::vec3& query) const {
+    if (m_nodes.empty()) {
+        return INVALID_ID;
+    }
+    float min_dist2 = std::numeric_limits<float>::max();
+    uint32_t min_idx = 0;
+    search(0, query, min_dist2, min_idx);
+    return m_ids[min_idx];
+}
+
+std::vector<uint32_t> KdTree::findNearest(
+        const std::vector<glm::vec3>& queries) const {
+    const uint32_t n_queries = static_cast<uint32_t>(queries.size());
+    std::vector<uint32_t> ret(n_queries);
+    const uint32_t n_chunks = (n_queries + QUERY_CHUNK - 1) / QUERY_CHUNK;
+    GetThreadPool().parallelFor(n_chunks, [&](uint32_t chunk_idx) {
+        const uint32_t end =
+                std::min((chunk_idx + 1) * QUERY_CHUNK, n_queries);
+        for (uint32_t i = chunk_idx * QUERY_CHUNK; i < end; i++) {
+            ret[i] = findNearest(queries[i]);
+        }
+    });
+    return ret;
+}
+
+uint32_t KdTree::buildNode(uint32_t begin, uint32_t end) {
+    const uint32_t node_idx = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({begin, end, 0, 0, 0, 0.f});
+    if (end - begin <= LEAF_SIZE) {
+        return node_idx;  // Leaf
+    }
+
+    // Split along the longest axis of the bounding box
+    glm::vec3 min_pos = m_points[begin], max_pos = m_points[begin];
+    for (uint32_t i = begin + 1; i < end; i++) {
+        min_pos = glm::min(min_pos, m_points[i]);
+        max_pos = glm::max(max_pos, m_points[i]);
+    }
+    const glm::vec3 extent = max_pos - min_pos;
+    uint32_t axis = 0;
+    if (extent[static_cast<int>(axis)] < extent.y) axis = 1;
+    if (extent[static_cast<int>(axis)] < extent.z) axis = 2;
+    const int axis_i = static_cast<int>(axis);
+
+    // Partition points and IDs together at the median
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::vector<uint32_t> order(end - begin);
+    std::iota(order.begin(), order.end(), begin);
+    std::nth_element(order.begin(), order.begin() + (mid - begin),
+                     order.end(), [&](uint32_t a, uint32_t b) {
+                         return m_points[a][axis_i] < m_points[b][axis_i];
+                     });
+    std::vector<glm::vec3> tmp_points(order.size());
+    std::vector<uint32_t> tmp_ids(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        tmp_points[i] = m_points[order[i]];
+        tmp_ids[i] = m_ids[order[i]];
+    }
+    std::copy(tmp_points.begin(), tmp_points.end(), m_points.begin() + begin);
+    std::copy(tmp_ids.begin(), tmp_ids.end(), m_ids.begin() + begin);
+
+    // Build children (`m_nodes` may be reallocated)
+    const float split = m_points[mid][axis_i];
+    const uint32_t left = buildNode(begin, mid);
+    const uint32_t right = buildNode(mid, end);
+    m_nodes[node_idx].left = left;
+    m_nodes[node_idx].right = right;
+    m_nodes[node_idx].axis = axis;
+    m_nodes[node_idx].split = split;
+    return node_idx;
+}
+
+void KdTree::search(uint32_t node_idx, const glm::vec3& query,
+                    float& min_dist2, uint32_t& min_idx) const {
+    const Node& node = m_nodes[node_idx];
+    if (node.left == 0) {
+        // Leaf
+        for (uint32_t i = node.begin; i < node.end; i++) {
+            const float dist2 = Distance2(m_points[i], query);
+            if (dist2 < min_dist2) {
+                min_dist2 = dist2;
+                min_idx = i;
+            }
+        }
+        return;
+    }
+
+    // Visit the nearer side first, then the other if it can be closer
+    const float diff = query[static_cast<int>(node.axis)] - node.split;
+    const uint32_t near_idx = (diff < 0.f) ? node.left : node.right;
+    const uint32_t far_idx = (diff < 0.f) ? node.right : node.left;
+    search(near_idx, query, min_dist2, min_idx);
+    if (diff * diff < min_dist2) {
+        search(far_idx, query, min_dist2, min_idx);
+    }
+}
+
+uint32_t FindNearestBruteForce(const std::vector<glm::vec3>& points,
+                               const std::vector<uint32_t>& ids,
+                               const glm::vec3& query) {
+    uint32_t ret = KdTree::INVALID_ID;
+    float min_dist2 = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < points.size(); i++) {
+        const float dist2 = Distance2(points[i], query);
+        if (dist2 < min_dist2) {
+            min_dist2 = dist2;
+            ret = ids[i];
+        }
+    }
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
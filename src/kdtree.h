@@ -0,0 +1,57 @@
+#ifndef KDTREE_H_20210214
+#define KDTREE_H_20210214
+#include <vkw/warning_suppressor.h>
+
+#include <cstdint>
+#include <vector>
+
+BEGIN_VKW_SUPPRESS_WARNING
+#include <glm/glm.hpp>
+END_VKW_SUPPRESS_WARNING
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- KD-Tree ----------------------------------
+// -----------------------------------------------------------------------------
+// Nearest neighbor search over 3D points, each of which has a user ID.
+class KdTree {
+public:
+    static constexpr uint32_t INVALID_ID = uint32_t(~0);
+
+    void build(const std::vector<glm::vec3>& points,
+               const std::vector<uint32_t>& ids);
+    bool empty() const;
+    size_t size() const;
+
+    // Returns ID of the nearest point (`INVALID_ID` for empty tree)
+    uint32_t findNearest(const glm::vec3& query) const;
+    // Batched version (queries are processed in parallel)
+    std::vector<uint32_t> findNearest(
+            const std::vector<glm::vec3>& queries) const;
+
+private:
+    struct Node {
+        uint32_t begin, end;   // Range in `m_points`
+        uint32_t left, right;  // Child node indices (0 for leaf)
+        uint32_t axis;
+        float split;
+    };
+
+    uint32_t buildNode(uint32_t begin, uint32_t end);
+    void search(uint32_t node_idx, const glm::vec3& query, float& min_dist2,
+                uint32_t& min_idx) const;
+
+    std::vector<glm::vec3> m_points;  // Reordered points
+    std::vector<uint32_t> m_ids;      // Reordered IDs
+    std::vector<Node> m_nodes;        // Root is the first one
+};
+
+// Reference implementation to validate the tree
+uint32_t FindNearestBruteForce(const std::vector<glm::vec3>& points,
+                               const std::vector<uint32_t>& ids,
+                               const glm::vec3& query);
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
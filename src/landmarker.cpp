@@ -1,8 +1,43 @@
 #include "landmarker.h"
 
-#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "log.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+#define LANDMARKER_USE_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define LANDMARKER_USE_NEON
+#include <arm_neon.h>
+#endif
 
 namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const uint32_t ROW_CHUNK = 16;  // Rows per conversion task
+
+// Tracking
+const uint32_t TRACK_VERIFY_INTERVAL = 10;  // Frames between detector checks
+const double TRACK_ROI_SCALE = 2.0;  // Detector region over face rectangle
+const double TRACK_SPREAD_TOL = 1.25;  // Allowed scale change of landmarks
+const double TRACK_MAX_SHIFT = 0.3;    // Allowed shift over landmark spread
+
+// Mesh region
+const double ROI_MARGIN = 1.2;      // Cropped region over projected mesh box
+const double ROI_MESH_SIZE = 200.0;  // Longer side of mesh box after rescale
+const uint32_t BOX_RELATE_INTERVAL = 30;  // Frames between relating mesh box
+const double BOX_SCALE_TOL = 1.25;   // Allowed size change of mesh box
+const double BOX_ASPECT_TOL = 1.15;  // Allowed aspect change of mesh box
+
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -10,22 +45,124 @@ inline uint8_t CastUint(float v) {
     return static_cast<uint8_t>(std::min(std::max(v * 255.f, 0.f), 255.f));
 }
 
-dlib::array2d<dlib::rgb_pixel> CastToDlibImg(const FloatImage& img) {
-    // Allocate
-    dlib::array2d<dlib::rgb_pixel> dlib_img;
+inline uint8_t CastUint(uint8_t v) {
+    return v;
+}
+
+// Casts 4 RGBA pixels to bytes (same rounding as `CastUint`)
+inline void CastUint4(const float* src, uint8_t* dst) {
+#if defined(LANDMARKER_USE_SSE)
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) {
+        __m128 f = _mm_mul_ps(_mm_loadu_ps(src + i * 4), scale);
+        f = _mm_min_ps(_mm_max_ps(f, zero), scale);
+        v[i] = _mm_cvttps_epi32(f);  // Truncation
+    }
+    const __m128i v01 = _mm_packs_epi32(v[0], v[1]);
+    const __m128i v23 = _mm_packs_epi32(v[2], v[3]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                     _mm_packus_epi16(v01, v23));
+#elif defined(LANDMARKER_USE_NEON)
+    const float32x4_t scale = vdupq_n_f32(255.f);
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    uint16x4_t v[4];
+    for (int i = 0; i < 4; i++) {
+        float32x4_t f = vmulq_f32(vld1q_f32(src + i * 4), scale);
+        f = vminq_f32(vmaxq_f32(f, zero), scale);
+        v[i] = vmovn_u32(vcvtq_u32_f32(f));  // Truncation
+    }
+    vst1q_u8(dst, vcombine_u8(vmovn_u16(vcombine_u16(v[0], v[1])),
+                              vmovn_u16(vcombine_u16(v[2], v[3]))));
+#else
+    for (int i = 0; i < 16; i++) {
+        dst[i] = CastUint(src[i]);
+    }
+#endif
+}
+
+void CastRow(const float* src, uint32_t n_ch, uint32_t width,
+             dlib::rgb_pixel* dst) {
+    uint32_t x = 0;
+    if (n_ch == 4) {
+        // 4 pixels at once
+        alignas(16) uint8_t rgba[16];
+        for (; x + 4 <= width; x += 4) {
+            CastUint4(src + x * 4, rgba);
+            for (uint32_t i = 0; i < 4; i++) {
+                dst[x + i] = {rgba[i * 4 + 0], rgba[i * 4 + 1],
+                              rgba[i * 4 + 2]};
+            }
+        }
+    }
+    for (; x < width; x++) {
+        const float* p = src + x * n_ch;
+        dst[x] = {CastUint(p[0]), CastUint(p[1]), CastUint(p[2])};
+    }
+}
+
+void CastRow(const uint8_t* src, uint32_t n_ch, uint32_t width,
+             dlib::rgb_pixel* dst) {
+    for (uint32_t x = 0; x < width; x++) {
+        const uint8_t* p = src + x * n_ch;
+        dst[x] = {p[0], p[1], p[2]};
+    }
+}
+
+template <typename T>
+void CastToDlibImgImpl(const ImageView<T>& img,
+                       dlib::array2d<dlib::rgb_pixel>& dlib_img) {
+    // Allocate (kept when the size is unchanged)
     dlib_img.set_size(img.height, img.width);
 
-    // Cast
-    for (uint32_t y = 0; y < img.height; y++) {
-        for (uint32_t x = 0; x < img.width; x++) {
-            const float& r = img.pixels[(y * img.width + x) * img.n_ch + 0];
-            const float& g = img.pixels[(y * img.width + x) * img.n_ch + 1];
-            const float& b = img.pixels[(y * img.width + x) * img.n_ch + 2];
-            dlib_img[y][x] = {CastUint(r), CastUint(g), CastUint(b)};
+    // Cast in parallel by rows
+    const uint32_t n_chunks = (img.height + ROW_CHUNK - 1) / ROW_CHUNK;
+    GetThreadPool().parallelFor(n_chunks, [&](uint32_t chunk_idx) {
+        const uint32_t end = std::min((chunk_idx + 1) * ROW_CHUNK, img.height);
+        for (uint32_t y = chunk_idx * ROW_CHUNK; y < end; y++) {
+            CastRow(img.pixels + y * img.width * img.n_ch, img.n_ch,
+                    img.width, &dlib_img[y][0]);
         }
+    });
+}
+
+// Bounding box of landmarks
+dlib::drectangle GetLandmarkBox(const dlib::full_object_detection& dlib_lmk) {
+    dlib::drectangle box;
+    for (unsigned long i = 0; i < dlib_lmk.num_parts(); i++) {
+        box += dlib::dpoint(dlib_lmk.part(i));
     }
+    return box;
+}
 
-    return dlib_img;
+float Median(std::vector<float>& vals) {
+    const auto mid = vals.begin() + static_cast<long>(vals.size() / 2);
+    std::nth_element(vals.begin(), mid, vals.end());
+    return *mid;
+}
+
+bool IsInside(const dlib::full_object_detection& dlib_lmk,
+              const dlib::rectangle& img_rect) {
+    for (unsigned long i = 0; i < dlib_lmk.num_parts(); i++) {
+        if (!img_rect.contains(dlib_lmk.part(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks that sizes and aspects of boxes are within tolerances
+bool IsSimilarBox(const dlib::drectangle& box, const dlib::drectangle& ref) {
+    if (ref.width() < 1.0 || ref.height() < 1.0 || box.width() < 1.0 ||
+        box.height() < 1.0) {
+        return false;
+    }
+    const double scale = std::sqrt(box.area() / ref.area());
+    const double aspect = (box.width() / box.height()) /
+                          (ref.width() / ref.height());
+    return 1.0 / BOX_SCALE_TOL <= scale && scale <= BOX_SCALE_TOL &&
+           1.0 / BOX_ASPECT_TOL <= aspect && aspect <= BOX_ASPECT_TOL;
 }
 
 // -----------------------------------------------------------------------------
@@ -33,76 +170,347 @@ dlib::array2d<dlib::rgb_pixel> CastToDlibImg(const FloatImage& img) {
 // -----------------------------------------------------------------------------
 }  // namespace
 
+// -----------------------------------------------------------------------------
+// ------------------------------ dlib Image Cast ------------------------------
+// -----------------------------------------------------------------------------
+void CastToDlibImg(const FloatImageView& img,
+                   dlib::array2d<dlib::rgb_pixel>& dlib_img) {
+    ProfileZone zone("CastToDlibImg");
+    CastToDlibImgImpl(img, dlib_img);
+}
+
+void CastToDlibImg(const ByteImageView& img,
+                   dlib::array2d<dlib::rgb_pixel>& dlib_img) {
+    ProfileZone zone("CastToDlibImg");
+    CastToDlibImgImpl(img, dlib_img);
+}
+
 // -----------------------------------------------------------------------------
 // ----------------------------- Landmark Detector -----------------------------
 // -----------------------------------------------------------------------------
-LandmarkDetector::LandmarkDetector(const std::string& predictor_path) {
-    m_detector = dlib::get_frontal_face_detector();
-    dlib::deserialize(predictor_path) >> m_predictor;
+std::shared_ptr<const LandmarkModel> LoadLandmarkModel(
+        const std::string& predictor_path) {
+    auto model = std::make_shared<LandmarkModel>();
+    model->detector = dlib::get_frontal_face_detector();
+    if (IsCompactShapePredictor(predictor_path)) {
+        model->compact_predictor.open(predictor_path);  // Mapped
+    } else {
+        dlib::deserialize(predictor_path) >> model->predictor;
+    }
+    return model;
 }
 
+LandmarkDetector::LandmarkDetector(const std::string& predictor_path)
+    : LandmarkDetector(LoadLandmarkModel(predictor_path)) {}
+
+LandmarkDetector::LandmarkDetector(std::shared_ptr<const LandmarkModel> model)
+    : m_model(std::move(model)), m_detector(m_model->detector) {}
+
 std::vector<Landmark> LandmarkDetector::detect(const FloatImage& col_img,
                                                const FloatImage& pos_img,
+                                               const glm::mat4& mvpc_mat,
                                                const Mesh& mesh) {
+    ProfileZone zone("LandmarkDetector::detect");
+    // Cast to dlib image (vertex indices are searched from positions)
+    FrameView frame;
+    frame.color_f = GetView(col_img);
+    frame.pos = GetView(pos_img);
+    frame.mvpc_mat = mvpc_mat;
+    CastToDlibImg(frame.color_f, m_col_img);
+    m_prev_zero_copy = false;
+    auto faces = detectOnDlibImg(m_col_img, frame, mesh, false);
+    return faces.empty() ? std::vector<Landmark>() : std::move(faces[0]);
+}
+
+std::vector<Landmark> LandmarkDetector::detect(const FrameView& frame,
+                                               const Mesh& mesh) {
+    auto faces = detectOnFrame(frame, mesh, false);
+    return faces.empty() ? std::vector<Landmark>() : std::move(faces[0]);
+}
+
+std::vector<std::vector<Landmark>> LandmarkDetector::detectFaces(
+        const FrameView& frame, const Mesh& mesh) {
+    return detectOnFrame(frame, mesh, true);
+}
+
+void LandmarkDetector::setZeroCopy(bool enabled) {
+    m_zero_copy = enabled;
+}
+
+void LandmarkDetector::setTracking(bool enabled) {
+    m_tracking = enabled;
+    m_track_valid = false;
+}
+
+void LandmarkDetector::setFaceRegion(FaceRegion region) {
+    m_face_region = region;
+    m_box_valid = false;
+}
+
+std::vector<std::vector<Landmark>> LandmarkDetector::detectOnFrame(
+        const FrameView& frame, const Mesh& mesh, bool multi_face) {
+    ProfileZone zone("LandmarkDetector::detect");
+    // Adapt RGBA8 buffer directly
+    if (m_zero_copy && !frame.color.empty() && frame.color.n_ch == 4) {
+        m_rgba_img = {frame.color.pixels, long(frame.color.height),
+                      long(frame.color.width)};
+        m_prev_zero_copy = true;
+        return detectOnDlibImg(m_rgba_img, frame, mesh, multi_face);
+    }
+
     // Cast to dlib image
-    auto&& col_img_dlib = CastToDlibImg(col_img);
+    if (!frame.color.empty()) {
+        CastToDlibImg(frame.color, m_col_img);
+    } else {
+        CastToDlibImg(frame.color_f, m_col_img);
+    }
+    m_prev_zero_copy = false;
+    return detectOnDlibImg(m_col_img, frame, mesh, multi_face);
+}
 
-    // Detect face
-    const std::vector<dlib::rectangle> face_rects = m_detector(col_img_dlib);
-    std::cout << "Detected faces: " << face_rects.size() << std::endl;
-    if (face_rects.size() != 1) {
-        return {};
+template <typename DlibImg>
+std::vector<std::vector<Landmark>> LandmarkDetector::detectOnDlibImg(
+        const DlibImg& col_img_dlib, const FrameView& frame, const Mesh& mesh,
+        bool multi_face) {
+    // Track face from the previous landmarks (single face only)
+    std::vector<dlib::full_object_detection> dlib_lmks(1);
+    const bool tracked = !multi_face && m_tracking && m_track_valid &&
+                         trackFace(col_img_dlib, dlib_lmks[0]);
+
+    if (!tracked) {
+        // Find faces
+        const std::vector<dlib::rectangle> face_rects =
+                findFaces(col_img_dlib, frame, mesh, multi_face);
+        if (face_rects.empty() || (!multi_face && face_rects.size() != 1)) {
+            m_track_valid = false;
+            return {};
+        }
+
+        // Predict 2D landmarks of faces in parallel (predictor is immutable)
+        dlib_lmks.resize(face_rects.size());
+        GetThreadPool().parallelFor(
+                static_cast<uint32_t>(face_rects.size()),
+                [&](uint32_t face_idx) {
+                    ProfileZone zone("ShapePredictor");
+                    dlib_lmks[face_idx] = m_model->predict(
+                            col_img_dlib, face_rects[face_idx]);
+                });
+        m_track_valid =
+                !multi_face && updateTrack(face_rects[0], dlib_lmks[0]);
     }
-    const auto& face_rect = face_rects[0];
 
-    // Predict 2D landmarks
-    dlib::full_object_detection dlib_lmk = m_predictor(col_img_dlib, face_rect);
-
-    // Parse landmarks
-    std::vector<Landmark> landmarks;
-    for (uint32_t i = 0; i < dlib_lmk.num_parts(); i++) {
-        // 2D landmark
-        const uint32_t x_2d = dlib_lmk.part(i).x();
-        const uint32_t y_2d = dlib_lmk.part(i).y();
-        glm::ivec2 lmk_2d{x_2d, y_2d};
-
-        // 3D landmark
-        const auto& width = pos_img.width;
-        const auto& n_ch = pos_img.n_ch;
-        const float& x_3d = pos_img.pixels[(y_2d * width + x_2d) * n_ch + 0];
-        const float& y_3d = pos_img.pixels[(y_2d * width + x_2d) * n_ch + 1];
-        const float& z_3d = pos_img.pixels[(y_2d * width + x_2d) * n_ch + 2];
-        glm::vec3 lmk_3d{x_3d, y_3d, z_3d};
-
-        // Search nearest vertex (TODO: Use KD-tree)
-        uint32_t vtx_idx = uint32_t(~0);
-        if (x_3d != 0.f && y_3d != 0.f && z_3d != 0.f) {  // Escape background
-            float min_dist = std::numeric_limits<float>::max();
-            for (auto&& vtx : mesh.vertices) {
-                float dist = glm::distance(vtx.pos, lmk_3d);
-                if (dist < min_dist) {
-                    min_dist = dist;
-                    vtx_idx = vtx.vtx_idx;
-                }
-            }
+    // 2D landmarks of all faces
+    std::vector<glm::ivec2> lmk_2ds;
+    for (auto&& dlib_lmk : dlib_lmks) {
+        for (uint32_t i = 0; i < dlib_lmk.num_parts(); i++) {
+            lmk_2ds.emplace_back(dlib_lmk.part(i).x(), dlib_lmk.part(i).y());
         }
+    }
+
+    // Look up 3D landmarks only at the 2D ones (at once for all faces)
+    const std::vector<SurfacePoint>& points =
+            QuerySurfacePoints(frame, mesh, lmk_2ds);
 
-        // Pack
-        Landmark lmk{lmk_2d, lmk_3d, vtx_idx};
-        landmarks.push_back(lmk);
+    // Pack for each face
+    std::vector<std::vector<Landmark>> faces(dlib_lmks.size());
+    size_t i = 0;
+    for (size_t face_idx = 0; face_idx < faces.size(); face_idx++) {
+        for (uint32_t k = 0; k < dlib_lmks[face_idx].num_parts(); k++, i++) {
+            faces[face_idx].push_back(
+                    {lmk_2ds[i], points[i].pos, points[i].vtx_idx});
+        }
     }
 
-    // Store
-    m_prev_col_img = std::move(col_img_dlib);
-    m_prev_lmk = std::move(dlib_lmk);
+    // Store (the image is kept in `m_col_img` or `m_rgba_img`)
+    m_prev_lmks = std::move(dlib_lmks);
 
-    return landmarks;
+    return faces;
+}
+
+template <typename DlibImg>
+bool LandmarkDetector::trackFace(const DlibImg& col_img_dlib,
+                                 dlib::full_object_detection& dlib_lmk) {
+    // Expected face rectangle from the previous landmarks
+    const dlib::drectangle prev_box = GetLandmarkBox(m_prev_lmks[0]);
+    const dlib::dpoint prev_center = dlib::center(prev_box);
+    dlib::rectangle face_rect = m_track_rel.apply(prev_box);
+    const dlib::rectangle img_rect = dlib::get_rect(col_img_dlib);
+
+    // Check with detector on a small region at intervals
+    const bool verify = (TRACK_VERIFY_INTERVAL <= ++m_n_tracked);
+    if (verify) {
+        const dlib::rectangle roi =
+                dlib::centered_rect(
+                        face_rect,
+                        static_cast<unsigned long>(face_rect.width() *
+                                                   TRACK_ROI_SCALE),
+                        static_cast<unsigned long>(face_rect.height() *
+                                                   TRACK_ROI_SCALE))
+                        .intersect(img_rect);
+        ProfileZone zone("FaceDetector");
+        const std::vector<dlib::rectangle> face_rects =
+                m_detector(dlib::sub_image(col_img_dlib, roi));
+        if (face_rects.size() != 1) {
+            return false;
+        }
+        face_rect = dlib::translate_rect(face_rects[0], roi.tl_corner());
+    }
+
+    // Predict 2D landmarks
+    {
+        ProfileZone zone("ShapePredictor");
+        dlib_lmk = m_model->predict(col_img_dlib, face_rect);
+    }
+
+    // Check landmark spread and motion
+    const dlib::drectangle box = GetLandmarkBox(dlib_lmk);
+    const double scale_x = box.width() / prev_box.width();
+    const double scale_y = box.height() / prev_box.height();
+    const dlib::dpoint shift = dlib::center(box) - prev_center;
+    if (!IsInside(dlib_lmk, img_rect) ||
+        scale_x < 1.0 / TRACK_SPREAD_TOL || TRACK_SPREAD_TOL < scale_x ||
+        scale_y < 1.0 / TRACK_SPREAD_TOL || TRACK_SPREAD_TOL < scale_y ||
+        TRACK_MAX_SHIFT * prev_box.width() < std::abs(shift.x()) ||
+        TRACK_MAX_SHIFT * prev_box.height() < std::abs(shift.y())) {
+        return false;
+    }
+
+    if (verify) {
+        updateTrack(face_rect, dlib_lmk);
+    }
+    return true;
+}
+
+bool LandmarkDetector::updateTrack(
+        const dlib::rectangle& face_rect,
+        const dlib::full_object_detection& dlib_lmk) {
+    // Relate detected rectangle with landmarks
+    if (!m_track_rel.relate(face_rect, GetLandmarkBox(dlib_lmk))) {
+        return false;
+    }
+    m_n_tracked = 0;
+    return true;
+}
+
+template <typename DlibImg>
+std::vector<dlib::rectangle> LandmarkDetector::findFaces(
+        const DlibImg& col_img_dlib, const FrameView& frame, const Mesh& mesh,
+        bool multi_face) {
+    // Project mesh bounds with the drawn matrix
+    const dlib::rectangle img_rect = dlib::get_rect(col_img_dlib);
+    glm::vec2 min_pix, max_pix;
+    if (m_face_region == FaceRegion::IMAGE ||
+        !ProjectMeshBox(frame.mvpc_mat, mesh,
+                        static_cast<uint32_t>(img_rect.width()),
+                        static_cast<uint32_t>(img_rect.height()), min_pix,
+                        max_pix)) {
+        // Detect over whole image
+        ProfileZone zone("FaceDetector");
+        const std::vector<dlib::rectangle> face_rects =
+                m_detector(col_img_dlib);
+        Log(LogLevel::DEBUG, "Detected faces: ", face_rects.size());
+        return face_rects;
+    }
+    const dlib::drectangle mesh_box(min_pix.x, min_pix.y, max_pix.x,
+                                    max_pix.y);
+
+    // Use projected box directly (the box may contain several heads for
+    // multiple faces)
+    const bool use_box = !multi_face && m_face_region == FaceRegion::MESH_BOX;
+    if (use_box && m_box_valid && m_box_mesh_id == mesh.id &&
+        ++m_n_boxed < BOX_RELATE_INTERVAL &&
+        IsSimilarBox(mesh_box, m_box_ref)) {
+        return {m_box_rel.apply(mesh_box)};
+    }
+
+    // Crop the region around the mesh (rescaled for a single face)
+    const dlib::dpoint center = dlib::center(mesh_box);
+    const double roi_w = mesh_box.width() * ROI_MARGIN;
+    const double roi_h = mesh_box.height() * ROI_MARGIN;
+    const dlib::drectangle roi(center.x() - roi_w / 2.0,
+                               center.y() - roi_h / 2.0,
+                               center.x() + roi_w / 2.0,
+                               center.y() + roi_h / 2.0);
+    const double scale =
+            multi_face ? 1.0 :
+                         ROI_MESH_SIZE /
+                                 std::max(mesh_box.width(), mesh_box.height());
+    const auto n_rows = static_cast<unsigned long>(
+            std::max(std::ceil(roi_h * scale), 2.0));
+    const auto n_cols = static_cast<unsigned long>(
+            std::max(std::ceil(roi_w * scale), 2.0));
+    dlib::extract_image_chip(col_img_dlib,
+                             dlib::chip_details(roi, {n_rows, n_cols}),
+                             m_roi_img);
+
+    // Detect in the region
+    std::vector<dlib::rectangle> chip_rects;
+    {
+        ProfileZone zone("FaceDetector");
+        chip_rects = m_detector(m_roi_img);
+    }
+    Log(LogLevel::DEBUG, "Detected faces: ", chip_rects.size());
+
+    // Map back to image (chip corners are at region corners)
+    const double to_img_x = roi.width() / double(n_cols - 1);
+    const double to_img_y = roi.height() / double(n_rows - 1);
+    std::vector<dlib::rectangle> face_rects;
+    for (auto&& chip_rect : chip_rects) {
+        face_rects.emplace_back(
+                std::lround(roi.left() + chip_rect.left() * to_img_x),
+                std::lround(roi.top() + chip_rect.top() * to_img_y),
+                std::lround(roi.left() + chip_rect.right() * to_img_x),
+                std::lround(roi.top() + chip_rect.bottom() * to_img_y));
+    }
+
+    // Relate with mesh box for the next frames (again after an interval, or
+    // when the mesh, pose or view changes the box)
+    if (use_box) {
+        m_box_valid = (face_rects.size() == 1) &&
+                      m_box_rel.relate(face_rects[0], mesh_box);
+        m_box_mesh_id = mesh.id;
+        m_box_ref = mesh_box;
+        m_n_boxed = 0;
+    }
+    return face_rects;
+}
+
+bool LandmarkDetector::RectRelation::relate(const dlib::rectangle& rect,
+                                            const dlib::drectangle& ref) {
+    if (ref.width() < 1.0 || ref.height() < 1.0) {
+        return false;  // Degenerated
+    }
+    const dlib::dpoint rect_center = dlib::center(dlib::drectangle(rect));
+    const dlib::dpoint ref_center = dlib::center(ref);
+    dx = (rect_center.x() - ref_center.x()) / ref.width();
+    dy = (rect_center.y() - ref_center.y()) / ref.height();
+    sx = rect.width() / ref.width();
+    sy = rect.height() / ref.height();
+    return true;
+}
+
+dlib::rectangle LandmarkDetector::RectRelation::apply(
+        const dlib::drectangle& ref) const {
+    const dlib::dpoint ref_center = dlib::center(ref);
+    const double w = ref.width() * sx;
+    const double h = ref.height() * sy;
+    const double cx = ref_center.x() + ref.width() * dx;
+    const double cy = ref_center.y() + ref.height() * dy;
+    return dlib::rectangle(std::lround(cx - w / 2.0),
+                           std::lround(cy - h / 2.0),
+                           std::lround(cx + w / 2.0),
+                           std::lround(cy + h / 2.0));
 }
 
 void LandmarkDetector::show() const {
     // Show debug image (color)
-    dlib::image_window col_dlib_window(m_prev_col_img);
-    col_dlib_window.add_overlay(dlib::render_face_detections({m_prev_lmk}));
+    dlib::image_window col_dlib_window;
+    if (m_prev_zero_copy) {
+        col_dlib_window.set_image(m_rgba_img);
+    } else {
+        col_dlib_window.set_image(m_col_img);
+    }
+    col_dlib_window.add_overlay(dlib::render_face_detections(m_prev_lmks));
     col_dlib_window.wait_until_closed();
 
     // Show debug image (position)
@@ -112,6 +520,149 @@ void LandmarkDetector::show() const {
     // pos_dlib_window.wait_until_closed();
 }
 
+// -----------------------------------------------------------------------------
+// -------------------------- Landmark Detector Pool ---------------------------
+// -----------------------------------------------------------------------------
+void LandmarkDetectorPool::Releaser::operator()(
+        LandmarkDetector* detector) const {
+    std::lock_guard<std::mutex> lock(pool->m_mutex);
+    pool->m_free_detectors.emplace_back(detector);
+}
+
+LandmarkDetectorPool::LandmarkDetectorPool(const std::string& predictor_path,
+                                           const Setup& setup)
+    : LandmarkDetectorPool(LoadLandmarkModel(predictor_path), setup) {}
+
+LandmarkDetectorPool::LandmarkDetectorPool(
+        std::shared_ptr<const LandmarkModel> model, const Setup& setup)
+    : m_model(std::move(model)), m_setup(setup) {}
+
+LandmarkDetectorPool::DetectorPtr LandmarkDetectorPool::acquire() {
+    {
+        // Reuse a released one
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free_detectors.empty()) {
+            LandmarkDetector* detector = m_free_detectors.back().release();
+            m_free_detectors.pop_back();
+            return DetectorPtr(detector, Releaser{this});
+        }
+    }
+
+    // Create new one out of the lock (copies the face detector)
+    auto detector = std::make_unique<LandmarkDetector>(m_model);
+    if (m_setup) {
+        m_setup(*detector);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_n_created++;  // Counted only when created successfully
+    }
+    return DetectorPtr(detector.release(), Releaser{this});
+}
+
+size_t LandmarkDetectorPool::getNumCreated() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_n_created;
+}
+
+// -----------------------------------------------------------------------------
+// ---------------------------- Multi-view Detector ----------------------------
+// -----------------------------------------------------------------------------
+std::vector<Landmark> FuseLandmarks(
+        const std::vector<std::vector<Landmark>>& view_lmks) {
+    // Views with detection
+    std::vector<const std::vector<Landmark>*> valid_lmks;
+    for (auto&& lmks : view_lmks) {
+        if (!lmks.empty()) {
+            valid_lmks.push_back(&lmks);
+        }
+    }
+    if (valid_lmks.empty()) {
+        return {};
+    }
+    const size_t n_lmks = valid_lmks[0]->size();
+    for (auto&& lmks : valid_lmks) {
+        if (lmks->size() != n_lmks) {
+            throw std::runtime_error("Number of landmarks mismatch in views");
+        }
+    }
+
+    std::vector<Landmark> fused(n_lmks);
+    for (size_t lmk_idx = 0; lmk_idx < n_lmks; lmk_idx++) {
+        // Vote vertex index (background is voted only without others)
+        std::unordered_map<uint32_t, uint32_t> n_votes;
+        uint32_t vtx_idx = INVALID_VTX_IDX;
+        uint32_t max_votes = 0;
+        for (auto&& lmks : valid_lmks) {
+            const uint32_t idx = (*lmks)[lmk_idx].vtx_idx;
+            if (idx == INVALID_VTX_IDX) {
+                continue;
+            }
+            const uint32_t n = ++n_votes[idx];
+            if (max_votes < n) {
+                max_votes = n;
+                vtx_idx = idx;
+            }
+        }
+
+        // Median position of the agreeing views
+        std::vector<float> xs, ys, zs;
+        const Landmark* first = nullptr;
+        for (auto&& lmks : valid_lmks) {
+            const Landmark& lmk = (*lmks)[lmk_idx];
+            if (lmk.vtx_idx != vtx_idx) {
+                continue;
+            }
+            if (!first) {
+                first = &lmk;
+            }
+            xs.push_back(lmk.lmk_3d.x);
+            ys.push_back(lmk.lmk_3d.y);
+            zs.push_back(lmk.lmk_3d.z);
+        }
+        fused[lmk_idx] = *first;
+        fused[lmk_idx].lmk_3d = {Median(xs), Median(ys), Median(zs)};
+    }
+    return fused;
+}
+
+MultiViewLandmarkDetector::MultiViewLandmarkDetector(
+        const std::string& predictor_path, uint32_t n_views)
+    : m_view_lmks(n_views) {
+    // Share model (detectors keep per-view states and buffers)
+    const auto model = LoadLandmarkModel(predictor_path);
+    for (uint32_t i = 0; i < n_views; i++) {
+        m_detectors.push_back(std::make_unique<LandmarkDetector>(model));
+    }
+}
+
+uint32_t MultiViewLandmarkDetector::getNumViews() const {
+    return static_cast<uint32_t>(m_detectors.size());
+}
+
+LandmarkDetector& MultiViewLandmarkDetector::getDetector(uint32_t view_idx) {
+    return *m_detectors.at(view_idx);
+}
+
+std::vector<Landmark> MultiViewLandmarkDetector::detect(
+        const std::vector<FrameView>& frames, const Mesh& mesh) {
+    if (frames.size() != m_detectors.size()) {
+        throw std::runtime_error("Number of frames and views mismatch");
+    }
+
+    // Detect on views concurrently (idle threads take the next view)
+    GetThreadPool().parallelFor(getNumViews(), [&](uint32_t view_idx) {
+        m_view_lmks[view_idx] =
+                m_detectors[view_idx]->detect(frames[view_idx], mesh);
+    });
+
+    return FuseLandmarks(m_view_lmks);
+}
+
+const std::vector<Landmark>& MultiViewLandmarkDetector::getViewLandmarks(
+        uint32_t view_idx) const {
+    return m_view_lmks.at(view_idx);
+}
 
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -1,5 +1,10 @@
 #ifndef LANDMARKER_H_20210213
 #define LANDMARKER_H_20210213
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "compact_predictor.h"
 #include "image.h"
 #include "renderer.h"
 
@@ -11,6 +16,48 @@ BEGIN_VKW_SUPPRESS_WARNING
 #include <dlib/image_processing/render_face_detections.h>
 END_VKW_SUPPRESS_WARNING
 
+// -----------------------------------------------------------------------------
+// ------------------------------ dlib Image View ------------------------------
+// -----------------------------------------------------------------------------
+// Non-owning RGBA8 image for dlib's generic image interface. Read only, so
+// only the const accessors are provided (dlib reads inputs through them).
+struct DlibRgbaView {
+    const uint8_t* pixels = nullptr;
+    long n_rows = 0;
+    long n_cols = 0;
+};
+
+namespace dlib {
+template <>
+struct image_traits<DlibRgbaView> {
+    typedef rgb_alpha_pixel pixel_type;
+};
+}  // namespace dlib
+
+// Found by argument-dependent lookup from dlib's templates, so they are in the
+// namespace of `DlibRgbaView`
+inline long num_rows(const DlibRgbaView& img) {
+    return img.n_rows;
+}
+inline long num_columns(const DlibRgbaView& img) {
+    return img.n_cols;
+}
+inline long width_step(const DlibRgbaView& img) {
+    return img.n_cols * static_cast<long>(sizeof(dlib::rgb_alpha_pixel));
+}
+inline const void* image_data(const DlibRgbaView& img) {
+    return img.pixels;
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------ dlib Image Cast ------------------------------
+// -----------------------------------------------------------------------------
+// Casts to dlib RGB image in parallel (the buffer is kept for the same size)
+void CastToDlibImg(const FloatImageView& img,
+                   dlib::array2d<dlib::rgb_pixel>& dlib_img);
+void CastToDlibImg(const ByteImageView& img,
+                   dlib::array2d<dlib::rgb_pixel>& dlib_img);
+
 // -----------------------------------------------------------------------------
 // -------------------------- Landmark Correspondence --------------------------
 // -----------------------------------------------------------------------------
@@ -23,19 +70,179 @@ struct Landmark {
 // -----------------------------------------------------------------------------
 // ----------------------------- Landmark Detector -----------------------------
 // -----------------------------------------------------------------------------
+// Region where faces are searched when not tracked
+enum class FaceRegion {
+    IMAGE,     // Whole image
+    MESH_ROI,  // Cropped and rescaled region where the mesh projects
+    MESH_BOX,  // Projected mesh box fed to the predictor without detection
+               // (related to the detector by `MESH_ROI` at intervals, and
+               // again when the mesh or the size of its box changes)
+};
+
+// Models loaded once and shared read-only between detectors
+struct LandmarkModel {
+    dlib::frontal_face_detector detector;  // Prototype copied to detectors
+    dlib::shape_predictor predictor;       // Used in place (immutable)
+    CompactShapePredictor compact_predictor;  // Used instead when opened
+
+    unsigned long numParts() const {
+        return compact_predictor.empty() ? predictor.num_parts() :
+                                           compact_predictor.num_parts();
+    }
+
+    template <typename ImgType>
+    dlib::full_object_detection predict(const ImgType& img,
+                                        const dlib::rectangle& rect) const {
+        return compact_predictor.empty() ? predictor(img, rect) :
+                                           compact_predictor(img, rect);
+    }
+};
+
+// Loads both dlib and compact predictor files (see `ConvertShapePredictor`)
+std::shared_ptr<const LandmarkModel> LoadLandmarkModel(
+        const std::string& predictor_path);
+
+// Not thread-safe, as it keeps buffers and previous results. Use one for each
+// thread, sharing the model.
 class LandmarkDetector {
 public:
     LandmarkDetector(const std::string& predictor_path);
+    LandmarkDetector(std::shared_ptr<const LandmarkModel> model);
+    // `mvpc_mat` is the drawn matrix (`CLIP_MAT * mvp_mat`), which locates
+    // the mesh for `FaceRegion::MESH_ROI` and `MESH_BOX`
     std::vector<Landmark> detect(const FloatImage& col_img,
-                                 const FloatImage& pos_img, const Mesh& mesh);
+                                 const FloatImage& pos_img,
+                                 const glm::mat4& mvpc_mat, const Mesh& mesh);
+    std::vector<Landmark> detect(const FrameView& frame, const Mesh& mesh);
+    // Detects all faces (landmarks grouped for each face). Tracking and
+    // `FaceRegion::MESH_BOX` are not used, as they follow a single face.
+    std::vector<std::vector<Landmark>> detectFaces(const FrameView& frame,
+                                                   const Mesh& mesh);
+    // Detects on RGBA8 frames in place without conversion. dlib computes HOG
+    // of RGBA pixels from intensity, so faces may differ slightly from RGB.
+    void setZeroCopy(bool enabled);
+    // Derives the face rectangle from the previous landmarks instead of
+    // detecting over the whole image. Results are checked by landmark spread
+    // and by the detector on a small region at intervals, and full detection
+    // runs only on failure. For sequences with small camera motion.
+    void setTracking(bool enabled);
+    void setFaceRegion(FaceRegion region);
+    // Shows the last result (the frame must be still valid for zero-copy)
     void show() const;
 
 private:
-    dlib::frontal_face_detector m_detector;
-    dlib::shape_predictor m_predictor;
+    std::vector<std::vector<Landmark>> detectOnFrame(const FrameView& frame,
+                                                     const Mesh& mesh,
+                                                     bool multi_face);
+    template <typename DlibImg>
+    std::vector<std::vector<Landmark>> detectOnDlibImg(
+            const DlibImg& col_img_dlib, const FrameView& frame,
+            const Mesh& mesh, bool multi_face);
+    template <typename DlibImg>
+    bool trackFace(const DlibImg& col_img_dlib,
+                   dlib::full_object_detection& dlib_lmk);
+    bool updateTrack(const dlib::rectangle& face_rect,
+                     const dlib::full_object_detection& dlib_lmk);
+    template <typename DlibImg>
+    std::vector<dlib::rectangle> findFaces(const DlibImg& col_img_dlib,
+                                           const FrameView& frame,
+                                           const Mesh& mesh, bool multi_face);
+
+    // Face rectangle relative to a reference box (center offset and size
+    // ratio), measured when the detector found the face
+    struct RectRelation {
+        double dx = 0.0, dy = 0.0, sx = 1.0, sy = 1.0;
+
+        bool relate(const dlib::rectangle& rect, const dlib::drectangle& ref);
+        dlib::rectangle apply(const dlib::drectangle& ref) const;
+    };
+
+    std::shared_ptr<const LandmarkModel> m_model;
+    dlib::frontal_face_detector m_detector;  // Own copy (scanner is mutable)
+    bool m_zero_copy = false;
+    bool m_tracking = false;
+    FaceRegion m_face_region = FaceRegion::IMAGE;
 
-    dlib::array2d<dlib::rgb_pixel> m_prev_col_img;
-    dlib::full_object_detection m_prev_lmk;
+    // Tracking (reference is the bounding box of landmarks)
+    bool m_track_valid = false;
+    RectRelation m_track_rel;
+    uint32_t m_n_tracked = 0;  // Frames since the last detector check
+
+    // Mesh box (reference is the projected mesh box)
+    bool m_box_valid = false;
+    RectRelation m_box_rel;
+    uint64_t m_box_mesh_id = 0;  // Mesh and its box when related
+    dlib::drectangle m_box_ref;
+    uint32_t m_n_boxed = 0;  // Frames since related
+
+    dlib::array2d<dlib::rgb_pixel> m_col_img;  // Reused conversion buffer
+    dlib::array2d<dlib::rgb_pixel> m_roi_img;  // Reused cropped region
+    DlibRgbaView m_rgba_img;                   // Last zero-copy frame
+    bool m_prev_zero_copy = false;
+    std::vector<dlib::full_object_detection> m_prev_lmks;
+};
+
+// -----------------------------------------------------------------------------
+// -------------------------- Landmark Detector Pool ---------------------------
+// -----------------------------------------------------------------------------
+// Hands out detectors sharing one model to worker threads. A detector is used
+// by one thread until released, and is created when all are in use. Its
+// previous results are of any former user, so enable tracking only for
+// detectors dedicated to a sequence.
+class LandmarkDetectorPool {
+public:
+    using Setup = std::function<void(LandmarkDetector&)>;
+
+    struct Releaser {
+        LandmarkDetectorPool* pool = nullptr;
+        void operator()(LandmarkDetector* detector) const;
+    };
+    using DetectorPtr = std::unique_ptr<LandmarkDetector, Releaser>;
+
+    // `setup` is called for each created detector (e.g. `setZeroCopy`)
+    LandmarkDetectorPool(const std::string& predictor_path,
+                         const Setup& setup = {});
+    LandmarkDetectorPool(std::shared_ptr<const LandmarkModel> model,
+                         const Setup& setup = {});
+    LandmarkDetectorPool(const LandmarkDetectorPool&) = delete;
+    LandmarkDetectorPool& operator=(const LandmarkDetectorPool&) = delete;
+
+    // Returned back to the pool when the pointer is destructed (the pool must
+    // outlive it)
+    DetectorPtr acquire();
+    size_t getNumCreated() const;
+
+private:
+    std::shared_ptr<const LandmarkModel> m_model;
+    Setup m_setup;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<LandmarkDetector>> m_free_detectors;
+    size_t m_n_created = 0;
+};
+
+// -----------------------------------------------------------------------------
+// ---------------------------- Multi-view Detector ----------------------------
+// -----------------------------------------------------------------------------
+// Fuses landmarks detected on views of the same mesh. Vertex index is voted,
+// and 3D position is the median of the agreeing views (2D is from the first of
+// them). Views without detection are skipped.
+std::vector<Landmark> FuseLandmarks(
+        const std::vector<std::vector<Landmark>>& view_lmks);
+
+class MultiViewLandmarkDetector {
+public:
+    MultiViewLandmarkDetector(const std::string& predictor_path,
+                              uint32_t n_views);
+    uint32_t getNumViews() const;
+    LandmarkDetector& getDetector(uint32_t view_idx);  // For settings
+    // Detects on all views concurrently, then fuses the results
+    std::vector<Landmark> detect(const std::vector<FrameView>& frames,
+                                 const Mesh& mesh);
+    const std::vector<Landmark>& getViewLandmarks(uint32_t view_idx) const;
+
+private:
+    std::vector<std::unique_ptr<LandmarkDetector>> m_detectors;
+    std::vector<std::vector<Landmark>> m_view_lmks;
 };
 
 // -----------------------------------------------------------------------------
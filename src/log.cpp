@@ -0,0 +1,51 @@
+#include "log.h"
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const char* const LEVEL_NAMES[] = {"error", "warn", "info", "debug"};
+
+std::atomic<LogLevel> g_log_level{LogLevel::WARN};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ------------------------------------ Log ------------------------------------
+// -----------------------------------------------------------------------------
+void SetLogLevel(LogLevel level) {
+    g_log_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel GetLogLevel() {
+    return g_log_level.load(std::memory_order_relaxed);
+}
+
+LogLevel ParseLogLevel(const std::string& name) {
+    for (int i = 0; i <= static_cast<int>(LogLevel::DEBUG); i++) {
+        if (name == LEVEL_NAMES[i]) {
+            return static_cast<LogLevel>(i);
+        }
+    }
+    throw std::runtime_error("Unknown log level: " + name);
+}
+
+void WriteLogLine(LogLevel level, const std::string& msg) {
+    // One write for each line (not interleaved between threads)
+    const std::string line = std::string("[") +
+                             LEVEL_NAMES[static_cast<int>(level)] + "] " +
+                             msg + "\n";
+    std::fwrite(line.data(), 1, line.size(), stderr);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
@@ -0,0 +1,40 @@
+#ifndef LOG_H_20210219
+#define LOG_H_20210219
+
+#include <sstream>
+#include <string>
+
+// -----------------------------------------------------------------------------
+// ------------------------------------ Log ------------------------------------
+// -----------------------------------------------------------------------------
+enum class LogLevel {
+    ERROR = 0,
+    WARN,
+    INFO,
+    DEBUG,  // Per-frame diagnostics
+};
+
+void SetLogLevel(LogLevel level);
+LogLevel GetLogLevel();
+// Parses "error", "warn", "info" or "debug" (throws for others)
+LogLevel ParseLogLevel(const std::string& name);
+
+// Writes one line to stderr at once (without flush)
+void WriteLogLine(LogLevel level, const std::string& msg);
+
+// Arguments are formatted only when `level` is enabled
+template <typename... Args>
+void Log(LogLevel level, const Args&... args) {
+    if (GetLogLevel() < level) {
+        return;
+    }
+    std::ostringstream ss;
+    (ss << ... << args);
+    WriteLogLine(level, ss.str());
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
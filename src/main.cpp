@@ -1,9 +1,17 @@
+#include <chrono>
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
+#include "batch.h"
 #include "image.h"
 #include "landmarker.h"
+#include "log.h"
+#include "profiler.h"
 #include "renderer.h"
+#include "result_sink.h"
+#include "service.h"
 
 namespace {
 
@@ -18,32 +26,140 @@ const uint32_t WIN_W = 600;
 const uint32_t WIN_H = 600;
 const float FOV = glm::radians(20.f);
 const float CAM_DIST_SCALE = 1.5f / glm::tan(FOV);
+// Camera poses of multi-view mode (yaw and pitch in degrees)
+const std::vector<glm::vec2> VIEW_POSES = {
+        {0.f, 0.f}, {-25.f, 0.f}, {25.f, 0.f}, {0.f, -15.f}, {0.f, 15.f}};
+// Offscreen renderers of service mode (each with a render thread)
+const uint32_t N_SERVICE_RENDERERS = 2;
 
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
-glm::mat4 GenViewMatrix(const Mesh& mesh, float dist_scale) {
-    // Compute bounding box
-    glm::vec3 min_pos(std::numeric_limits<float>::max(),
-                      std::numeric_limits<float>::max(),
-                      std::numeric_limits<float>::max());
-    glm::vec3 max_pos(std::numeric_limits<float>::lowest(),
-                      std::numeric_limits<float>::lowest(),
-                      std::numeric_limits<float>::lowest());
-    for (auto&& vtx : mesh.vertices) {
-        min_pos = glm::min(vtx.pos, min_pos);
-        max_pos = glm::max(vtx.pos, max_pos);
-    }
+glm::mat4 GenViewMatrix(const Mesh& mesh, float dist_scale,
+                        const glm::vec2& pose = {0.f, 0.f}) {
+    // Bounding box
+    const glm::vec3& min_pos = mesh.min_pos;
+    const glm::vec3& max_pos = mesh.max_pos;
     auto center_pos = (min_pos + max_pos) / 2.f;
 
-    // Camera position
+    // Camera position (rotated around the center by yaw and pitch)
     float radius = glm::distance(max_pos, min_pos) / 2.f;
-    glm::vec3 cam_pos(center_pos.x, center_pos.y,
-                      center_pos.z + radius * dist_scale);
+    const float yaw = glm::radians(pose.x);
+    const float pitch = glm::radians(pose.y);
+    const glm::vec3 cam_dir(glm::sin(yaw) * glm::cos(pitch), glm::sin(pitch),
+                            glm::cos(yaw) * glm::cos(pitch));
+    glm::vec3 cam_pos = center_pos + cam_dir * (radius * dist_scale);
 
     return glm::lookAt(cam_pos, center_pos, glm::vec3(0.f, 1.f, 0.f));
 }
 
+std::vector<glm::mat4> GenMvpMatrices(const Mesh& mesh,
+                                      const std::vector<glm::vec2>& poses) {
+    const glm::mat4 MODEL_MAT = glm::scale(glm::vec3(1.00f));
+    const glm::mat4 PROJ_MAT = glm::perspective(
+            FOV, static_cast<float>(WIN_W) / static_cast<float>(WIN_H), 0.1f,
+            1000.f);
+    std::vector<glm::mat4> mvp_mats;
+    for (auto&& pose : poses) {
+        const glm::mat4 view_mat = GenViewMatrix(mesh, CAM_DIST_SCALE, pose);
+        mvp_mats.push_back(PROJ_MAT * view_mat * MODEL_MAT);
+    }
+    return mvp_mats;
+}
+
+float GetElapsedMs(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+}
+
+void PrintUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--cpu] [--headless] [--multiview]"
+              << " [--batch <directory or list file>]"
+              << " [--serve <socket path or ->]"
+              << " [--output <file or ->] [--format jsonl|binary]"
+              << " [--log error|warn|info|debug]"
+              << " [--profile <trace json>]" << std::endl;
+}
+
+int RunBatchMode(const std::string& list_path, RenderBackend backend,
+                 const std::vector<glm::vec2>& view_poses, ResultSink& sink) {
+    const std::vector<std::string> filenames = ListMeshFiles(list_path);
+    Renderer renderer(WIN_W, WIN_H, backend);  // Offscreen
+
+    // Meshes are independent, so faces are searched around each mesh
+    LandmarkDetectorPool detectors(
+            PREDICTOR_PATH, [](LandmarkDetector& detector) {
+                detector.setFaceRegion(FaceRegion::MESH_ROI);
+            });
+
+    BatchConfig config;
+    config.gen_mvp_mats = [&](const Mesh& mesh) {
+        return GenMvpMatrices(mesh, view_poses);
+    };
+
+    // Write records
+    uint32_t n_failed = 0;
+    RunBatch(filenames, renderer, detectors, config,
+             [&](const BatchResult& result) {
+                 if (result.status == ResultStatus::FAILED) {
+                     n_failed++;
+                     Log(LogLevel::WARN, "Failed: ", result.filename, ": ",
+                         result.error);
+                 }
+                 sink.write(result);
+             });
+    sink.close();
+    Log(LogLevel::INFO, "Processed ", filenames.size(), " meshes (",
+        n_failed, " failed)");
+    // Records of all meshes are written, but scripts see failures
+    return (n_failed == 0) ? 0 : 1;
+}
+
+int RunServiceMode(const std::string& socket_path, RenderBackend backend) {
+    // Model, device and pipeline are loaded once (Vulkan render sessions share
+    // one device, and draw meshes concurrently)
+    std::vector<std::unique_ptr<Renderer>> renderers;
+    std::vector<Renderer*> renderer_ptrs;
+    const auto context =
+            (backend == RenderBackend::VULKAN) ? RenderContext::Create() :
+                                                 nullptr;
+    for (uint32_t i = 0; i < N_SERVICE_RENDERERS; i++) {
+        if (context) {
+            renderers.push_back(
+                    std::make_unique<Renderer>(context, WIN_W, WIN_H));
+        } else {
+            renderers.push_back(
+                    std::make_unique<Renderer>(WIN_W, WIN_H, backend));
+        }
+        renderer_ptrs.push_back(renderers.back().get());
+    }
+    LandmarkDetectorPool detectors(
+            PREDICTOR_PATH, [](LandmarkDetector& detector) {
+                detector.setFaceRegion(FaceRegion::MESH_ROI);
+            });
+    ServiceConfig config;
+    config.gen_mvp_mats = GenMvpMatrices;
+    LandmarkService service(renderer_ptrs, detectors, config);
+
+    if (socket_path == "-") {
+        ServeStdin(service);
+    } else {
+        ServeUnixSocket(service, socket_path);
+    }
+    service.stop();
+    return 0;
+}
+
+void WriteProfile(const std::string& trace_path) {
+    if (trace_path.empty()) {
+        return;
+    }
+    SetProfiling(false);
+    WriteChromeTrace(trace_path);
+    std::cerr << FormatProfileStats(GetProfileStats());
+}
+
 }  // namespace
 
 // -----------------------------------------------------------------------------
@@ -51,62 +167,142 @@ glm::mat4 GenViewMatrix(const Mesh& mesh, float dist_scale) {
 // -----------------------------------------------------------------------------
 
 int main(int argc, char const* argv[]) {
-    (void)argc, (void)argv;
+    // Parse arguments
+    RenderBackend backend = RenderBackend::VULKAN;
+    bool headless = false;
+    bool multi_view = false;
+    std::string batch_path;
+    std::string output_path = "-";
+    ResultFormat output_format = ResultFormat::JSON_LINES;
+    std::string trace_path;
+    std::string serve_path;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg == "--cpu") {
+                backend = RenderBackend::CPU;
+            } else if (arg == "--headless") {
+                headless = true;
+            } else if (arg == "--multiview") {
+                multi_view = true;
+            } else if (arg == "--batch" && i + 1 < argc) {
+                batch_path = argv[++i];
+            } else if (arg == "--serve" && i + 1 < argc) {
+                serve_path = argv[++i];
+            } else if (arg == "--output" && i + 1 < argc) {
+                output_path = argv[++i];
+            } else if (arg == "--format" && i + 1 < argc) {
+                output_format = ParseResultFormat(argv[++i]);
+            } else if (arg == "--log" && i + 1 < argc) {
+                SetLogLevel(ParseLogLevel(argv[++i]));
+            } else if (arg == "--profile" && i + 1 < argc) {
+                trace_path = argv[++i];
+                SetProfiling(true);
+            } else {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception& e) {
+            // Invalid option values
+            std::cerr << e.what() << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    // Answer requests with warm model and device
+    if (!serve_path.empty()) {
+        const int ret = RunServiceMode(serve_path, backend);
+        WriteProfile(trace_path);
+        return ret;
+    }
+
+    // Results are written by a background thread
+    auto sink = CreateResultSink(output_path, output_format);
+    const std::vector<glm::vec2> view_poses =
+            multi_view ? VIEW_POSES : std::vector<glm::vec2>{{0.f, 0.f}};
 
-    // Create Vulkan window
-    const std::string WIN_TITLE = "Face Landmark 3D";
-    auto window = vkw::InitGLFWWindow(WIN_TITLE, WIN_W, WIN_H);
-    glfwHideWindow(window.get());
+    // Process many meshes without window
+    if (!batch_path.empty()) {
+        const int ret = RunBatchMode(batch_path, backend, view_poses, *sink);
+        WriteProfile(trace_path);
+        return ret;
+    }
 
-    // Create Renderer
-    Renderer renderer(window);
-    // Create Landmark detector
-    LandmarkDetector landmarker(PREDICTOR_PATH);
+    // Create Renderer (offscreen and CPU backend need no window)
+    vkw::WindowPtr window;
+    std::unique_ptr<Renderer> renderer_ptr;
+    if (backend == RenderBackend::VULKAN && !headless) {
+        // Create Vulkan window
+        const std::string WIN_TITLE = "Face Landmark 3D";
+        window = vkw::InitGLFWWindow(WIN_TITLE, WIN_W, WIN_H);
+        glfwHideWindow(window.get());
+        renderer_ptr = std::make_unique<Renderer>(window, backend);
+    } else {
+        renderer_ptr = std::make_unique<Renderer>(WIN_W, WIN_H, backend);
+    }
+    Renderer& renderer = *renderer_ptr;
+    renderer.setColorFormat(ColorFormat::RGBA8);
+    renderer.setDenseReadback(false);  // Landmarks are queried by ray casting
+    // Create Landmark detectors (one for each view)
+    const uint32_t n_views = static_cast<uint32_t>(view_poses.size());
+    MultiViewLandmarkDetector landmarker(PREDICTOR_PATH, n_views);
+    for (uint32_t view_idx = 0; view_idx < n_views; view_idx++) {
+        LandmarkDetector& detector = landmarker.getDetector(view_idx);
+        detector.setTracking(true);  // The camera moves little between frames
+        detector.setFaceRegion(FaceRegion::MESH_BOX);  // Mesh is known
+    }
+    // Next views are drawn during detection
+    renderer.setFramesInFlight(n_views * 2);
 
     // Load mesh
     renderer.loadObj(OBJ_FILENAME);
     const auto& mesh = renderer.getMesh();
 
-    // Camera matrix
-    const glm::mat4 MODEL_MAT = glm::scale(glm::vec3(1.00f));
-    const glm::mat4 view_mat = GenViewMatrix(mesh, CAM_DIST_SCALE);
-    const glm::mat4 PROJ_MAT = glm::perspective(
-            FOV, static_cast<float>(WIN_W) / static_cast<float>(WIN_H), 0.1f,
-            1000.f);
-    glm::mat4 mvp_mat = PROJ_MAT * view_mat * MODEL_MAT;
+    // Camera matrices
+    const std::vector<glm::mat4> mvp_mats = GenMvpMatrices(mesh, view_poses);
 
     // Rendering and Landmarking loop
-    while (!glfwWindowShouldClose(window.get())) {
-        // Render
-        auto&& col_pos_imgs = renderer.draw(mvp_mat);
-        auto&& col_img = std::get<0>(col_pos_imgs);
-        auto&& pos_img = std::get<1>(col_pos_imgs);
-
-        // Detect landmarks
-        const auto& lmks = landmarker.detect(col_img, pos_img, mesh);
-
-        if (!lmks.empty()) {
-            // Print result
-            for (uint32_t lmk_idx = 0; lmk_idx < lmks.size(); lmk_idx++) {
-                const auto& lmk = lmks[lmk_idx];
-                const auto& lmk_2d = lmk.lmk_2d;
-                const auto& lmk_3d = lmk.lmk_3d;
-                const auto& vtx_idx = lmk.vtx_idx;
-
-                std::cout << lmk_idx << ": " << std::endl;
-                std::cout << "  2d: " << lmk_2d.x << " " << lmk_2d.y
-                          << std::endl;
-                std::cout << "  3d: " << lmk_3d.x << " " << lmk_3d.y << " "
-                          << lmk_3d.z << std::endl;
-                std::cout << "  vertex index: " << vtx_idx << std::endl;
-            }
+    std::vector<DrawTicket> tickets = renderer.submitDraws(mvp_mats);
+    for (uint32_t frame_idx = 0;
+         !window || !glfwWindowShouldClose(window.get()); frame_idx++) {
+        ProfileZone zone("Frame");
+        ResultRecord record;
+        record.mesh_idx = frame_idx;
+        record.filename = OBJ_FILENAME;
 
-            // Show Dlib window (debug)
-            landmarker.show();
+        // Render (the next views are rendered during detection)
+        auto start = std::chrono::steady_clock::now();
+        std::vector<FrameView> frames;
+        for (auto&& ticket : tickets) {
+            frames.push_back(renderer.waitDrawView(ticket));
+        }
+        if (window) {
+            tickets = renderer.submitDraws(mvp_mats);
         }
+        record.render_ms = GetElapsedMs(start);
 
+        // Detect landmarks (fused over views)
+        start = std::chrono::steady_clock::now();
+        record.landmarks = landmarker.detect(frames, mesh);
+        record.detect_ms = GetElapsedMs(start);
+
+        // Write result
+        record.status = record.landmarks.empty() ? ResultStatus::NO_FACE :
+                                                   ResultStatus::OK;
+        sink->write(record);
+
+        // Show Dlib window (debug)
+        if (!record.landmarks.empty() && !headless) {
+            landmarker.getDetector(0).show();
+        }
+
+        if (!window) {
+            break;  // Without window, process only once
+        }
         glfwPollEvents();
     }
+    sink->close();
+    WriteProfile(trace_path);
 
     return 0;
 }
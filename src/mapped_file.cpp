@@ -0,0 +1,80 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// -------------------------------- Mapped File --------------------------------
+// -----------------------------------------------------------------------------
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& filename) {
+    auto ret = std::shared_ptr<MappedFile>(new MappedFile);
+#ifndef _WIN32
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+    ::close(fd);  // Mapping stays valid
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    ret->m_data = static_cast<const uint8_t*>(data);
+    ret->m_size = static_cast<size_t>(st.st_size);
+#else
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (!ifs) {
+        return nullptr;
+    }
+    ret->m_buf.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    ifs.read(reinterpret_cast<char*>(ret->m_buf.data()),
+             static_cast<std::streamsize>(ret->m_buf.size()));
+    ret->m_data = ret->m_buf.data();
+    ret->m_size = ret->m_buf.size();
+#endif
+    return ret;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (m_data) {
+        ::munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Temporary File ------------------------------
+// -----------------------------------------------------------------------------
+std::string GetTempFilename(const std::string& filename) {
+#ifndef _WIN32
+    const long pid = static_cast<long>(::getpid());
+#else
+    const long pid = static_cast<long>(::_getpid());
+#endif
+    std::stringstream ss;
+    ss << filename << "." << pid << "."
+       << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    return ss.str();
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
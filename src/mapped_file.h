@@ -0,0 +1,52 @@
+#ifndef MAPPED_FILE_H_20210224
+#define MAPPED_FILE_H_20210224
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// -------------------------------- Mapped File --------------------------------
+// -----------------------------------------------------------------------------
+// Read-only whole file mapping (read into memory where mmap is unavailable).
+// Pages are shared between processes mapping the same file.
+class MappedFile {
+public:
+    // Returns null when the file cannot be opened or is empty
+    static std::shared_ptr<MappedFile> Open(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> m_buf;
+#endif
+};
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Temporary File ------------------------------
+// -----------------------------------------------------------------------------
+// Unique temporary name next to `filename` (process and thread id), written
+// and then renamed over it, so concurrent writers never share a file
+std::string GetTempFilename(const std::string& filename);
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
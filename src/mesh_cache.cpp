@@ -0,0 +1,216 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "renderer.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const char MAGIC[8] = {'F', 'L', 'M', 'K', 'M', 'E', 'S', 'H'};
+const uint32_t VERSION = 1;
+const uint64_t ALIGNMENT = 16;  // Alignment of arrays in the file
+
+// -----------------------------------------------------------------------------
+// ------------------------------- File Structure ------------------------------
+// -----------------------------------------------------------------------------
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertex_bytes;  // Guard for `Vertex` layout
+    FileStamp obj_stamp;
+    FileStamp tex_stamp;
+    float min_pos[3];
+    float max_pos[3];
+    uint32_t tex_width, tex_height, tex_n_ch;
+    uint32_t tex_filename_len;
+    uint64_t n_vertices, n_indices;
+    uint64_t vertices_offset, indices_offset, tex_offset, tex_filename_offset;
+    uint64_t file_size;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+bool operator==(const FileStamp& a, const FileStamp& b) {
+    return a.mtime == b.mtime && a.size == b.size;
+}
+
+inline uint64_t AlignUp(uint64_t v) {
+    return (v + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Checks that `n` elements at `offset` are in the file (without overflow)
+inline bool IsInFile(uint64_t file_size, uint64_t offset, uint64_t n,
+                     uint64_t elem_bytes) {
+    return offset <= file_size && n <= (file_size - offset) / elem_bytes;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Mesh Cache --------------------------------
+// -----------------------------------------------------------------------------
+bool GetFileStamp(const std::string& filename, FileStamp& stamp) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const auto mtime = fs::last_write_time(filename, ec);
+    if (ec) {
+        return false;
+    }
+    const auto size = fs::file_size(filename, ec);
+    if (ec) {
+        return false;
+    }
+    stamp.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    stamp.size = static_cast<uint64_t>(size);
+    return true;
+}
+
+std::string GetMeshCachePath(const std::string& obj_filename) {
+    return obj_filename + ".cache";
+}
+
+bool LoadMeshCache(const std::string& cache_filename,
+                   const std::string& obj_filename, Mesh& mesh) {
+    // Map whole file
+    auto file = MappedFile::Open(cache_filename);
+    if (!file || file->size() < sizeof(CacheHeader)) {
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(&header, file->data(), sizeof(CacheHeader));
+
+    // Check format
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || header.vertex_bytes != sizeof(Vertex) ||
+        header.file_size != file->size()) {
+        return false;
+    }
+    const uint64_t file_size = file->size();
+    if (header.vertices_offset % ALIGNMENT != 0 ||
+        header.indices_offset % ALIGNMENT != 0 ||
+        header.tex_n_ch == 0 || 4 < header.tex_n_ch ||
+        header.n_indices % 3 != 0 ||
+        !IsInFile(file_size, header.vertices_offset, header.n_vertices,
+                  sizeof(Vertex)) ||
+        !IsInFile(file_size, header.indices_offset, header.n_indices,
+                  sizeof(uint32_t)) ||
+        !IsInFile(file_size, header.tex_offset,
+                  uint64_t(header.tex_width) * header.tex_height,
+                  header.tex_n_ch) ||
+        !IsInFile(file_size, header.tex_filename_offset,
+                  header.tex_filename_len, 1)) {
+        return false;  // Broken
+    }
+
+    // Check source files
+    FileStamp obj_stamp, tex_stamp;
+    const std::string tex_filename(
+            reinterpret_cast<const char*>(file->data() +
+                                          header.tex_filename_offset),
+            header.tex_filename_len);
+    if (!GetFileStamp(obj_filename, obj_stamp) ||
+        !(obj_stamp == header.obj_stamp) ||
+        !GetFileStamp(tex_filename, tex_stamp) ||
+        !(tex_stamp == header.tex_stamp)) {
+        return false;  // Stale
+    }
+
+    // Vertices and indices (small, copied for the search structures)
+    const auto vtx_ptr = reinterpret_cast<const Vertex*>(
+            file->data() + header.vertices_offset);
+    const auto idx_ptr = reinterpret_cast<const uint32_t*>(
+            file->data() + header.indices_offset);
+    for (uint64_t i = 0; i < header.n_indices; i++) {
+        if (header.n_vertices <= idx_ptr[i]) {
+            return false;  // Broken (indexes out of the vertices)
+        }
+    }
+    mesh.vertices.assign(vtx_ptr, vtx_ptr + header.n_vertices);
+    mesh.indices.assign(idx_ptr, idx_ptr + header.n_indices);
+    mesh.min_pos = {header.min_pos[0], header.min_pos[1], header.min_pos[2]};
+    mesh.max_pos = {header.max_pos[0], header.max_pos[1], header.max_pos[2]};
+
+    // Texture stays mapped (uploaded directly from the mapping)
+    mesh.color_tex = {file->data() + header.tex_offset, header.tex_width,
+                      header.tex_height, header.tex_n_ch};
+    mesh.color_tex_owner = std::move(file);
+    return true;
+}
+
+void SaveMeshCache(const std::string& cache_filename,
+                   const FileStamp& obj_stamp, const std::string& tex_filename,
+                   const FileStamp& tex_stamp, const Mesh& mesh) {
+    // Build header
+    CacheHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertex_bytes = sizeof(Vertex);
+    header.obj_stamp = obj_stamp;
+    header.tex_stamp = tex_stamp;
+    for (int i = 0; i < 3; i++) {
+        header.min_pos[i] = mesh.min_pos[i];
+        header.max_pos[i] = mesh.max_pos[i];
+    }
+    const ByteImageView& tex = mesh.color_tex;
+    header.tex_width = tex.width;
+    header.tex_height = tex.height;
+    header.tex_n_ch = tex.n_ch;
+    header.tex_filename_len = static_cast<uint32_t>(tex_filename.size());
+    header.n_vertices = mesh.vertices.size();
+    header.n_indices = mesh.indices.size();
+
+    // Layout
+    const uint64_t vtx_bytes = mesh.vertices.size() * sizeof(Vertex);
+    const uint64_t idx_bytes = mesh.indices.size() * sizeof(uint32_t);
+    const uint64_t tex_bytes = uint64_t(tex.width) * tex.height * tex.n_ch;
+    header.vertices_offset = AlignUp(sizeof(CacheHeader));
+    header.indices_offset = AlignUp(header.vertices_offset + vtx_bytes);
+    header.tex_offset = AlignUp(header.indices_offset + idx_bytes);
+    header.tex_filename_offset = header.tex_offset + tex_bytes;
+    header.file_size = header.tex_filename_offset + tex_filename.size();
+
+    // Write to temporary file, then replace (readers never see half files)
+    const std::string tmp_filename = GetTempFilename(cache_filename);
+    {
+        std::ofstream ofs(tmp_filename, std::ios::binary | std::ios::trunc);
+        if (!ofs) {
+            throw std::runtime_error("Failed to open " + tmp_filename);
+        }
+        auto write_at = [&](uint64_t offset, const void* data, uint64_t n) {
+            ofs.seekp(static_cast<std::streamoff>(offset));
+            ofs.write(static_cast<const char*>(data),
+                      static_cast<std::streamsize>(n));
+        };
+        write_at(0, &header, sizeof(CacheHeader));
+        write_at(header.vertices_offset, mesh.vertices.data(), vtx_bytes);
+        write_at(header.indices_offset, mesh.indices.data(), idx_bytes);
+        write_at(header.tex_offset, tex.pixels, tex_bytes);
+        write_at(header.tex_filename_offset, tex_filename.data(),
+                 tex_filename.size());
+        if (!ofs) {
+            throw std::runtime_error("Failed to write " + tmp_filename);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_filename, cache_filename, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_filename, ec);
+        throw std::runtime_error("Failed to replace " + cache_filename);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
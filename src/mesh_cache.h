@@ -0,0 +1,44 @@
+#ifndef MESH_CACHE_H_20210216
+#define MESH_CACHE_H_20210216
+
+#include <cstdint>
+#include <string>
+
+struct Mesh;
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Mesh Cache --------------------------------
+// -----------------------------------------------------------------------------
+// Versioned binary file of flattened vertices, indices, bounds and decoded
+// texture. It is invalidated by modification time and size of the source OBJ
+// and texture files.
+
+// Modification time and size of a source file
+struct FileStamp {
+    int64_t mtime = 0;
+    uint64_t size = 0;
+};
+
+// Returns false when the file cannot be stat'ed
+bool GetFileStamp(const std::string& filename, FileStamp& stamp);
+
+// Default cache path next to the OBJ file
+std::string GetMeshCachePath(const std::string& obj_filename);
+
+// Memory-maps the cache into `mesh` (texture pixels stay in the mapping).
+// Returns false when the cache is missing, stale or of another version.
+// Search structures of `mesh` are not built.
+bool LoadMeshCache(const std::string& cache_filename,
+                   const std::string& obj_filename, Mesh& mesh);
+
+// Writes the cache (throws when the file cannot be written). Stamps are taken
+// before the sources are read, so files replaced meanwhile make it stale.
+void SaveMeshCache(const std::string& cache_filename,
+                   const FileStamp& obj_stamp, const std::string& tex_filename,
+                   const FileStamp& tex_stamp, const Mesh& mesh);
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
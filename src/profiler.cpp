@@ -0,0 +1,218 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const size_t INITIAL_EVENTS = 4096;  // Reserved events for each thread
+const uint32_t GPU_TID = 0;          // Track of GPU zones in traces
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Thread Buffers ------------------------------
+// -----------------------------------------------------------------------------
+struct ProfileEvent {
+    const char* name;
+    int64_t start_ns;
+    int64_t dur_ns;
+    bool gpu;
+};
+
+// Written only by its thread
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::vector<ProfileEvent> events;
+};
+
+struct BufferRegistry {
+    std::mutex mutex;  // Only for registration and reading
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // Kept after exit
+    uint32_t next_tid = GPU_TID + 1;
+};
+
+std::atomic<bool> g_profiling{false};
+
+BufferRegistry& GetRegistry() {
+    static BufferRegistry registry;
+    return registry;
+}
+
+ThreadBuffer& GetThreadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> t_buffer = []() {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.reserve(INITIAL_EVENTS);
+        BufferRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer->tid = registry.next_tid++;
+        registry.buffers.push_back(buffer);
+        return buffer;
+    }();
+    return *t_buffer;
+}
+
+double GetPercentile(const std::vector<int64_t>& sorted_durs, double p) {
+    // Nearest rank
+    const size_t rank = static_cast<size_t>(
+            std::ceil(p * static_cast<double>(sorted_durs.size())));
+    const size_t idx = std::min(std::max(rank, size_t(1)),
+                                sorted_durs.size()) - 1;
+    return static_cast<double>(sorted_durs[idx]) * 1e-6;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- Profiler ---------------------------------
+// -----------------------------------------------------------------------------
+void SetProfiling(bool enabled) {
+    g_profiling.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsProfiling() {
+    return g_profiling.load(std::memory_order_relaxed);
+}
+
+int64_t GetProfileTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+void AddProfileEvent(const char* name, int64_t start_ns, int64_t dur_ns) {
+    GetThreadBuffer().events.push_back({name, start_ns, dur_ns, false});
+}
+
+void AddGpuProfileEvent(const char* name, int64_t start_ns, int64_t dur_ns) {
+    GetThreadBuffer().events.push_back({name, start_ns, dur_ns, true});
+}
+
+std::vector<ProfileStats> GetProfileStats() {
+    // Collect durations for each zone name (GPU zones are separated)
+    std::map<std::pair<std::string, bool>, std::vector<int64_t>> durs_map;
+    {
+        BufferRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto&& buffer : registry.buffers) {
+            for (auto&& event : buffer->events) {
+                durs_map[{event.name, event.gpu}].push_back(event.dur_ns);
+            }
+        }
+    }
+
+    std::vector<ProfileStats> stats_list;
+    for (auto&& key_durs : durs_map) {
+        std::vector<int64_t>& durs = key_durs.second;
+        std::sort(durs.begin(), durs.end());
+        ProfileStats stats;
+        stats.name = key_durs.first.first;
+        stats.gpu = key_durs.first.second;
+        stats.count = durs.size();
+        for (auto&& dur : durs) {
+            stats.total_ms += static_cast<double>(dur) * 1e-6;
+        }
+        stats.mean_ms = stats.total_ms / static_cast<double>(durs.size());
+        stats.p50_ms = GetPercentile(durs, 0.5);
+        stats.p90_ms = GetPercentile(durs, 0.9);
+        stats.p99_ms = GetPercentile(durs, 0.99);
+        stats.max_ms = static_cast<double>(durs.back()) * 1e-6;
+        stats_list.push_back(std::move(stats));
+    }
+    std::sort(stats_list.begin(), stats_list.end(),
+              [](const ProfileStats& a, const ProfileStats& b) {
+                  return a.total_ms > b.total_ms;
+              });
+    return stats_list;
+}
+
+std::string FormatProfileStats(const std::vector<ProfileStats>& stats) {
+    std::string ret;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-32s %8s %10s %9s %9s %9s %9s\n",
+                  "zone [ms]", "count", "total", "mean", "p50", "p90", "p99");
+    ret += line;
+    for (auto&& s : stats) {
+        const std::string name = s.gpu ? "[GPU] " + s.name : s.name;
+        std::snprintf(line, sizeof(line),
+                      "%-32s %8zu %10.2f %9.3f %9.3f %9.3f %9.3f\n",
+                      name.c_str(), s.count, s.total_ms, s.mean_ms, s.p50_ms,
+                      s.p90_ms, s.p99_ms);
+        ret += line;
+    }
+    return ret;
+}
+
+void WriteChromeTrace(const std::string& filename) {
+    BufferRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Timestamps from the first zone
+    int64_t origin_ns = std::numeric_limits<int64_t>::max();
+    for (auto&& buffer : registry.buffers) {
+        for (auto&& event : buffer->events) {
+            origin_ns = std::min(origin_ns, event.start_ns);
+        }
+    }
+
+    // Complete events ("X") in microseconds with thread names
+    std::string buf = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char tmp[256];
+    std::snprintf(tmp, sizeof(tmp),
+                  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                  "\"tid\":%u,\"args\":{\"name\":\"GPU\"}}",
+                  GPU_TID);
+    buf += tmp;
+    for (auto&& buffer : registry.buffers) {
+        std::snprintf(tmp, sizeof(tmp),
+                      ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                      "\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+                      buffer->tid, buffer->tid);
+        buf += tmp;
+        for (auto&& event : buffer->events) {
+            // Names are literals in the code (no escaping)
+            std::snprintf(tmp, sizeof(tmp),
+                          ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,"
+                          "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          event.name, event.gpu ? GPU_TID : buffer->tid,
+                          static_cast<double>(event.start_ns - origin_ns) *
+                                  1e-3,
+                          static_cast<double>(event.dur_ns) * 1e-3);
+            buf += tmp;
+        }
+    }
+    buf += "\n]}\n";
+
+    std::FILE* fp = std::fopen(filename.c_str(), "wb");
+    if (!fp) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    const bool ok = std::fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+    if (std::fclose(fp) != 0 || !ok) {
+        throw std::runtime_error("Failed to write " + filename);
+    }
+}
+
+void ClearProfile() {
+    BufferRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto&& buffer : registry.buffers) {
+        buffer->events.clear();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
@@ -0,0 +1,73 @@
+#ifndef PROFILER_H_20210222
+#define PROFILER_H_20210222
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- Profiler ---------------------------------
+// -----------------------------------------------------------------------------
+// Zones are recorded only while enabled (otherwise a zone costs one relaxed
+// atomic load). Each thread appends to its own buffer without locking, so
+// stats and traces must be read while no zone is being recorded.
+void SetProfiling(bool enabled);
+bool IsProfiling();
+
+// Monotonic time of zones
+int64_t GetProfileTimeNs();
+
+// Records a finished zone on the calling thread (`name` must outlive the
+// profile, e.g. a string literal)
+void AddProfileEvent(const char* name, int64_t start_ns, int64_t dur_ns);
+// Records a zone measured on GPU (shown on a separate track)
+void AddGpuProfileEvent(const char* name, int64_t start_ns, int64_t dur_ns);
+
+// Records the scope as a zone
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) {
+        if (IsProfiling()) {
+            m_name = name;
+            m_start_ns = GetProfileTimeNs();
+        }
+    }
+
+    ~ProfileZone() {
+        if (m_name) {
+            AddProfileEvent(m_name, m_start_ns,
+                            GetProfileTimeNs() - m_start_ns);
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* m_name = nullptr;  // Null when disabled
+    int64_t m_start_ns = 0;
+};
+
+// Aggregated durations of zones with the same name
+struct ProfileStats {
+    std::string name;
+    bool gpu = false;
+    size_t count = 0;
+    double total_ms = 0.0, mean_ms = 0.0;
+    double p50_ms = 0.0, p90_ms = 0.0, p99_ms = 0.0, max_ms = 0.0;
+};
+
+// Sorted by total time
+std::vector<ProfileStats> GetProfileStats();
+// Table of stats for humans
+std::string FormatProfileStats(const std::vector<ProfileStats>& stats);
+// Writes all zones in Chrome trace format (chrome://tracing, Perfetto)
+void WriteChromeTrace(const std::string& filename);
+// Drops recorded zones
+void ClearProfile();
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
@@ -0,0 +1,390 @@
+#include "rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "renderer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+#define RASTERIZER_USE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const uint32_t TILE_SIZE = 32;     // Pixels per tile side
+const uint32_t VTX_CHUNK = 16384;  // Vertices per transform task
+const uint32_t TRI_CHUNK = 8192;   // Triangles per setup task
+const float MIN_W = 1e-6f;         // Triangles crossing this are dropped
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+inline uint32_t DivUp(uint32_t a, uint32_t b) {
+    return (a + b - 1) / b;
+}
+
+inline float EdgeFunc(const glm::vec2& a, const glm::vec2& b,
+                      const glm::vec2& p) {
+    return (p.x - a.x) * (b.y - a.y) - (p.y - a.y) * (b.x - a.x);
+}
+
+inline int32_t WrapCoord(int32_t v, int32_t size) {
+    return ((v % size) + size) % size;
+}
+
+glm::vec4 FetchTexel(const ByteImageView& tex, int32_t x, int32_t y) {
+    const int32_t w = static_cast<int32_t>(tex.width);
+    const int32_t h = static_cast<int32_t>(tex.height);
+    const size_t idx = static_cast<size_t>(WrapCoord(y, h) * w +
+                                           WrapCoord(x, w)) *
+                       tex.n_ch;
+    glm::vec4 ret(0.f, 0.f, 0.f, 1.f);
+    for (uint32_t c = 0; c < std::min(tex.n_ch, 4u); c++) {
+        ret[static_cast<int>(c)] = tex.pixels[idx + c] * (1.f / 255.f);
+    }
+    return ret;
+}
+
+glm::vec4 SampleTexture(const ByteImageView& tex, const glm::vec2& uv) {
+    if (tex.empty()) {
+        return glm::vec4(1.f);
+    }
+    // Bilinear filter with repeat addressing (same as default sampler)
+    const float fx = uv.x * static_cast<float>(tex.width) - 0.5f;
+    const float fy = uv.y * static_cast<float>(tex.height) - 0.5f;
+    const float x0f = std::floor(fx);
+    const float y0f = std::floor(fy);
+    const float ax = fx - x0f;
+    const float ay = fy - y0f;
+    const int32_t x0 = static_cast<int32_t>(x0f);
+    const int32_t y0 = static_cast<int32_t>(y0f);
+    const glm::vec4 top = FetchTexel(tex, x0, y0) * (1.f - ax) +
+                          FetchTexel(tex, x0 + 1, y0) * ax;
+    const glm::vec4 btm = FetchTexel(tex, x0, y0 + 1) * (1.f - ax) +
+                          FetchTexel(tex, x0 + 1, y0 + 1) * ax;
+    return top * (1.f - ay) + btm * ay;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ------------------------ 3D Renderer by CPU Backend -------------------------
+// -----------------------------------------------------------------------------
+SoftRasterizer::SoftRasterizer(ThreadPool& pool) : m_pool(pool) {}
+
+std::tuple<FloatImage, FloatImage, std::vector<uint32_t>> SoftRasterizer::draw(
+        const Mesh& mesh, const glm::mat4& mvpc_mat, uint32_t width,
+        uint32_t height) {
+    // Resize buffers (depth rows are padded for 4-wide access)
+    m_width = width;
+    m_height = height;
+    m_n_tiles_x = DivUp(width, TILE_SIZE);
+    m_n_tiles_y = DivUp(height, TILE_SIZE);
+    m_depth_stride = DivUp(width, 4) * 4;
+    m_depth.resize(m_depth_stride * height);
+    FloatImage col_img = CreateImage(width, height, 4);
+    FloatImage pos_img = CreateImage(width, height, 4);
+    std::vector<uint32_t> id_img(width * height);
+
+    // Transform, set up and bin triangles
+    setupTriangles(mesh, mvpc_mat);
+
+    // Rasterize each tile independently
+    m_pool.parallelFor(m_n_tiles_x * m_n_tiles_y, [&](uint32_t tile_idx) {
+        rasterizeTile(mesh, tile_idx, col_img, pos_img, id_img);
+    });
+
+    return std::make_tuple(std::move(col_img), std::move(pos_img),
+                           std::move(id_img));
+}
+
+void SoftRasterizer::setupTriangles(const Mesh& mesh,
+                                    const glm::mat4& mvpc_mat) {
+    // Transform vertices
+    const uint32_t n_vtxs = static_cast<uint32_t>(mesh.vertices.size());
+    m_clip_pos.resize(n_vtxs);
+    m_pool.parallelFor(DivUp(n_vtxs, VTX_CHUNK), [&](uint32_t chunk_idx) {
+        const uint32_t end = std::min((chunk_idx + 1) * VTX_CHUNK, n_vtxs);
+        for (uint32_t i = chunk_idx * VTX_CHUNK; i < end; i++) {
+            m_clip_pos[i] = mvpc_mat * glm::vec4(mesh.vertices[i].pos, 1.f);
+        }
+    });
+
+    // Set up triangles and bin them into tiles (each chunk has own bins)
+    const uint32_t n_tris = static_cast<uint32_t>(mesh.indices.size() / 3);
+    const uint32_t n_chunks = DivUp(n_tris, TRI_CHUNK);
+    const uint32_t n_tiles = m_n_tiles_x * m_n_tiles_y;
+    const float img_w = static_cast<float>(m_width);
+    const float img_h = static_cast<float>(m_height);
+    m_tris.resize(n_chunks);
+    m_bins.resize(n_chunks);
+    m_pool.parallelFor(n_chunks, [&](uint32_t chunk_idx) {
+        auto& tris = m_tris[chunk_idx];
+        auto& bins = m_bins[chunk_idx];
+        tris.clear();
+        bins.resize(n_tiles);
+        for (auto&& bin : bins) {
+            bin.clear();
+        }
+
+        const uint32_t end = std::min((chunk_idx + 1) * TRI_CHUNK, n_tris);
+        for (uint32_t tri_idx = chunk_idx * TRI_CHUNK; tri_idx < end;
+             tri_idx++) {
+            // Project corners
+            Triangle tri;
+            bool valid = true;
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t vtx_idx = mesh.indices[tri_idx * 3 + k];
+                const glm::vec4& clip = m_clip_pos[vtx_idx];
+                if (clip.w < MIN_W) {
+                    valid = false;  // Behind the camera (not clipped)
+                    break;
+                }
+                const float inv_w = 1.f / clip.w;
+                tri.scr[k] = {(clip.x * inv_w * 0.5f + 0.5f) * img_w,
+                              (clip.y * inv_w * 0.5f + 0.5f) * img_h};
+                tri.z[k] = clip.z * inv_w;
+                tri.inv_w[k] = inv_w;
+                tri.vtx_idxs[k] = vtx_idx;
+            }
+            if (!valid) {
+                continue;
+            }
+            // Depth range rejection
+            if ((tri.z[0] < 0.f && tri.z[1] < 0.f && tri.z[2] < 0.f) ||
+                (1.f < tri.z[0] && 1.f < tri.z[1] && 1.f < tri.z[2])) {
+                continue;
+            }
+            // Make the signed area positive (no face culling)
+            const float area = EdgeFunc(tri.scr[0], tri.scr[1], tri.scr[2]);
+            if (area == 0.f || std::isnan(area)) {
+                continue;
+            }
+            if (area < 0.f) {
+                std::swap(tri.scr[1], tri.scr[2]);
+                std::swap(tri.z[1], tri.z[2]);
+                std::swap(tri.inv_w[1], tri.inv_w[2]);
+                std::swap(tri.vtx_idxs[1], tri.vtx_idxs[2]);
+            }
+
+            // Bounding box of covered pixel centers
+            const glm::vec2 min_scr =
+                    glm::min(glm::min(tri.scr[0], tri.scr[1]), tri.scr[2]);
+            const glm::vec2 max_scr =
+                    glm::max(glm::max(tri.scr[0], tri.scr[1]), tri.scr[2]);
+            tri.min_x = std::max(
+                    static_cast<int32_t>(std::floor(min_scr.x - 0.5f)), 0);
+            tri.min_y = std::max(
+                    static_cast<int32_t>(std::floor(min_scr.y - 0.5f)), 0);
+            tri.max_x = std::min(static_cast<int32_t>(std::ceil(max_scr.x)),
+                                 static_cast<int32_t>(m_width) - 1);
+            tri.max_y = std::min(static_cast<int32_t>(std::ceil(max_scr.y)),
+                                 static_cast<int32_t>(m_height) - 1);
+            if (tri.max_x < tri.min_x || tri.max_y < tri.min_y) {
+                continue;
+            }
+
+            // Register to overlapping tiles
+            const uint32_t local_idx = static_cast<uint32_t>(tris.size());
+            tris.push_back(tri);
+            const uint32_t tx0 = static_cast<uint32_t>(tri.min_x) / TILE_SIZE;
+            const uint32_t ty0 = static_cast<uint32_t>(tri.min_y) / TILE_SIZE;
+            const uint32_t tx1 = static_cast<uint32_t>(tri.max_x) / TILE_SIZE;
+            const uint32_t ty1 = static_cast<uint32_t>(tri.max_y) / TILE_SIZE;
+            for (uint32_t ty = ty0; ty <= ty1; ty++) {
+                for (uint32_t tx = tx0; tx <= tx1; tx++) {
+                    bins[ty * m_n_tiles_x + tx].push_back(local_idx);
+                }
+            }
+        }
+    });
+}
+
+void SoftRasterizer::rasterizeTile(const Mesh& mesh, uint32_t tile_idx,
+                                   FloatImage& col_img, FloatImage& pos_img,
+                                   std::vector<uint32_t>& id_img) {
+    const int32_t x0 = static_cast<int32_t>((tile_idx % m_n_tiles_x) *
+                                            TILE_SIZE);
+    const int32_t y0 = static_cast<int32_t>((tile_idx / m_n_tiles_x) *
+                                            TILE_SIZE);
+    const int32_t x1 = std::min(x0 + static_cast<int32_t>(TILE_SIZE),
+                                static_cast<int32_t>(m_width));
+    const int32_t y1 = std::min(y0 + static_cast<int32_t>(TILE_SIZE),
+                                static_cast<int32_t>(m_height));
+
+    // Clear (same values as the Vulkan clear colors)
+    const int32_t x1_pad = (x1 == static_cast<int32_t>(m_width)) ?
+                                   static_cast<int32_t>(m_depth_stride) :
+                                   x1;
+    for (int32_t y = y0; y < y1; y++) {
+        float* depth_row = &m_depth[static_cast<size_t>(y) * m_depth_stride];
+        std::fill(depth_row + x0, depth_row + x1_pad, 1.f);
+        for (int32_t x = x0; x < x1; x++) {
+            const size_t pix_idx = static_cast<size_t>(y) * m_width +
+                                   static_cast<size_t>(x);
+            col_img.pixels[pix_idx * 4 + 3] = 1.f;
+            pos_img.pixels[pix_idx * 4 + 3] = 1.f;
+            id_img[pix_idx] = INVALID_VTX_IDX;
+        }
+    }
+
+    // Fragment shading (perspective-correct interpolation)
+    auto shade = [&](const Triangle& tri, int32_t x, int32_t y, float l0,
+                     float l1, float l2) {
+        float q0 = l0 * tri.inv_w[0];
+        float q1 = l1 * tri.inv_w[1];
+        float q2 = l2 * tri.inv_w[2];
+        const float q_sum = q0 + q1 + q2;
+        q0 /= q_sum, q1 /= q_sum, q2 /= q_sum;
+        const Vertex& v0 = mesh.vertices[tri.vtx_idxs[0]];
+        const Vertex& v1 = mesh.vertices[tri.vtx_idxs[1]];
+        const Vertex& v2 = mesh.vertices[tri.vtx_idxs[2]];
+        const glm::vec3 pos = v0.pos * q0 + v1.pos * q1 + v2.pos * q2;
+        const glm::vec2 uv = v0.uv * q0 + v1.uv * q1 + v2.uv * q2;
+        const glm::vec4 col =
+                SampleTexture(mesh.color_tex, {uv.x, 1.f - uv.y});  // Y-flip
+
+        // Nearest corner
+        uint32_t vtx_idx = v0.vtx_idx;
+        float min_dist = glm::distance(pos, v0.pos);
+        for (const Vertex* v : {&v1, &v2}) {
+            const float dist = glm::distance(pos, v->pos);
+            if (dist < min_dist) {
+                min_dist = dist;
+                vtx_idx = v->vtx_idx;
+            }
+        }
+
+        const size_t pix_idx = static_cast<size_t>(y) * m_width +
+                               static_cast<size_t>(x);
+        for (int c = 0; c < 4; c++) {
+            col_img.pixels[pix_idx * 4 + static_cast<size_t>(c)] = col[c];
+        }
+        for (int c = 0; c < 3; c++) {
+            pos_img.pixels[pix_idx * 4 + static_cast<size_t>(c)] = pos[c];
+        }
+        id_img[pix_idx] = vtx_idx;
+    };
+
+    // Rasterize binned triangles in submission order
+    for (size_t chunk_idx = 0; chunk_idx < m_bins.size(); chunk_idx++) {
+        const auto& tris = m_tris[chunk_idx];
+        for (const uint32_t local_idx : m_bins[chunk_idx][tile_idx]) {
+            const Triangle& tri = tris[local_idx];
+            const int32_t rx0 = std::max(tri.min_x, x0);
+            const int32_t ry0 = std::max(tri.min_y, y0);
+            const int32_t rx1 = std::min(tri.max_x + 1, x1);
+            const int32_t ry1 = std::min(tri.max_y + 1, y1);
+
+            // Edge functions: w_k(p) = A_k * p.x + B_k * p.y + C_k
+            float ea[3], eb[3], ec[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                const glm::vec2& a = tri.scr[(k + 1) % 3];
+                const glm::vec2& b = tri.scr[(k + 2) % 3];
+                ea[k] = b.y - a.y;
+                eb[k] = a.x - b.x;
+                ec[k] = a.y * (b.x - a.x) - a.x * (b.y - a.y);
+            }
+            const float inv_area =
+                    1.f / EdgeFunc(tri.scr[0], tri.scr[1], tri.scr[2]);
+
+            for (int32_t y = ry0; y < ry1; y++) {
+                const float py = static_cast<float>(y) + 0.5f;
+                float* depth_row =
+                        &m_depth[static_cast<size_t>(y) * m_depth_stride];
+#ifdef RASTERIZER_USE_SSE
+                const __m128 lane_ofs = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 one = _mm_set1_ps(1.f);
+                __m128 ws_row[3], ws_step[3];
+                for (uint32_t k = 0; k < 3; k++) {
+                    ws_row[k] = _mm_set1_ps(eb[k] * py + ec[k]);
+                    ws_step[k] = _mm_set1_ps(ea[k]);
+                }
+                const __m128 px_min = _mm_set1_ps(static_cast<float>(rx0));
+                const __m128 px_max = _mm_set1_ps(static_cast<float>(rx1));
+                for (int32_t x = rx0 & ~3; x < rx1; x += 4) {  // Aligned
+                    // Edge functions of 4 pixels
+                    const __m128 px = _mm_add_ps(
+                            _mm_set1_ps(static_cast<float>(x)), lane_ofs);
+                    __m128 ws[3];
+                    __m128 inside = _mm_and_ps(_mm_cmpgt_ps(px, px_min),
+                                               _mm_cmplt_ps(px, px_max));
+                    for (uint32_t k = 0; k < 3; k++) {
+                        ws[k] = _mm_add_ps(_mm_mul_ps(ws_step[k], px),
+                                           ws_row[k]);
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(ws[k], zero));
+                    }
+                    if (_mm_movemask_ps(inside) == 0) {
+                        continue;
+                    }
+                    // Interpolate depth and test
+                    const __m128 inv_area_4 = _mm_set1_ps(inv_area);
+                    const __m128 l0 = _mm_mul_ps(ws[0], inv_area_4);
+                    const __m128 l1 = _mm_mul_ps(ws[1], inv_area_4);
+                    const __m128 l2 = _mm_mul_ps(ws[2], inv_area_4);
+                    const __m128 z = _mm_add_ps(
+                            _mm_add_ps(_mm_mul_ps(l0, _mm_set1_ps(tri.z[0])),
+                                       _mm_mul_ps(l1, _mm_set1_ps(tri.z[1]))),
+                            _mm_mul_ps(l2, _mm_set1_ps(tri.z[2])));
+                    const __m128 depth = _mm_loadu_ps(depth_row + x);
+                    __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+                    pass = _mm_and_ps(pass, _mm_cmpge_ps(z, zero));
+                    pass = _mm_and_ps(pass, _mm_cmple_ps(z, one));
+                    const int mask = _mm_movemask_ps(pass);
+                    if (mask == 0) {
+                        continue;
+                    }
+                    _mm_storeu_ps(depth_row + x,
+                                  _mm_or_ps(_mm_and_ps(pass, z),
+                                            _mm_andnot_ps(pass, depth)));
+                    // Shade passed pixels
+                    alignas(16) float l0s[4], l1s[4], l2s[4];
+                    _mm_store_ps(l0s, l0);
+                    _mm_store_ps(l1s, l1);
+                    _mm_store_ps(l2s, l2);
+                    for (int32_t lane = 0; lane < 4; lane++) {
+                        if (mask & (1 << lane)) {
+                            shade(tri, x + lane, y, l0s[lane], l1s[lane],
+                                  l2s[lane]);
+                        }
+                    }
+                }
+#else
+                for (int32_t x = rx0; x < rx1; x++) {
+                    const float px = static_cast<float>(x) + 0.5f;
+                    float ws[3];
+                    for (uint32_t k = 0; k < 3; k++) {
+                        ws[k] = ea[k] * px + eb[k] * py + ec[k];
+                    }
+                    if (ws[0] < 0.f || ws[1] < 0.f || ws[2] < 0.f) {
+                        continue;
+                    }
+                    const float l0 = ws[0] * inv_area;
+                    const float l1 = ws[1] * inv_area;
+                    const float l2 = ws[2] * inv_area;
+                    const float z = l0 * tri.z[0] + l1 * tri.z[1] +
+                                    l2 * tri.z[2];
+                    if (z < 0.f || 1.f < z || depth_row[x] <= z) {
+                        continue;
+                    }
+                    depth_row[x] = z;
+                    shade(tri, x, y, l0, l1, l2);
+                }
+#endif
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+#ifndef RASTERIZER_H_20210214
+#define RASTERIZER_H_20210214
+#include <vkw/warning_suppressor.h>
+
+#include <tuple>
+#include <vector>
+
+#include "image.h"
+#include "thread_pool.h"
+
+BEGIN_VKW_SUPPRESS_WARNING
+#include <glm/glm.hpp>
+END_VKW_SUPPRESS_WARNING
+
+struct Mesh;
+
+// -----------------------------------------------------------------------------
+// ------------------------ 3D Renderer by CPU Backend -------------------------
+// -----------------------------------------------------------------------------
+// Tile-binned software rasterizer which produces the same outputs as the
+// Vulkan pipeline (color, object-space position and `vtx_idx` of the nearest
+// corner). `mvpc_mat` must include the Vulkan clip correction (Y-flip and
+// [0, 1] depth).
+class SoftRasterizer {
+public:
+    SoftRasterizer(ThreadPool& pool = GetThreadPool());
+    std::tuple<FloatImage, FloatImage, std::vector<uint32_t>> draw(
+            const Mesh& mesh, const glm::mat4& mvpc_mat, uint32_t width,
+            uint32_t height);
+
+private:
+    struct Triangle {
+        glm::vec2 scr[3];     // Screen-space corners
+        float z[3];           // Depth of corners
+        float inv_w[3];       // 1 / w of corners
+        uint32_t vtx_idxs[3];  // Indices into `Mesh::vertices`
+        int32_t min_x, min_y, max_x, max_y;  // Clamped bounding box
+    };
+
+    void setupTriangles(const Mesh& mesh, const glm::mat4& mvpc_mat);
+    void rasterizeTile(const Mesh& mesh, uint32_t tile_idx,
+                       FloatImage& col_img, FloatImage& pos_img,
+                       std::vector<uint32_t>& id_img);
+
+    ThreadPool& m_pool;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_n_tiles_x = 0;
+    uint32_t m_n_tiles_y = 0;
+    uint32_t m_depth_stride = 0;
+    std::vector<float> m_depth;                    // Padded depth buffer
+    std::vector<glm::vec4> m_clip_pos;             // Transformed vertices
+    std::vector<std::vector<Triangle>> m_tris;     // Per setup chunk
+    std::vector<std::vector<std::vector<uint32_t>>> m_bins;  // [chunk][tile]
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
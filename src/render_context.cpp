@@ -0,0 +1,335 @@
+#include "render_context.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "log.h"
+#include "mapped_file.h"
+
+#ifdef FACELMK3D_SPIRV
+#include "shaders/RENDER_FRAG_ID_SPV.h"
+#include "shaders/RENDER_FRAG_SPV.h"
+#include "shaders/RENDER_FRAG_WINDOW_ID_SPV.h"
+#include "shaders/RENDER_FRAG_WINDOW_SPV.h"
+#include "shaders/RENDER_VERT_SPV.h"
+#else
+#include "shaders/shader_sources.h"
+#endif
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- Shaders ----------------------------------
+// -----------------------------------------------------------------------------
+#ifdef FACELMK3D_SPIRV
+vkw::ShaderModulePackPtr CreateShader(const vk::UniqueDevice& device,
+                                      const uint32_t* spv, size_t n_bytes,
+                                      vk::ShaderStageFlagBits stage) {
+    auto shader_module = device->createShaderModuleUnique(
+            {vk::ShaderModuleCreateFlags(), n_bytes, spv});
+    return std::make_shared<vkw::ShaderModulePack>(
+            vkw::ShaderModulePack{std::move(shader_module), stage});
+}
+#else
+std::string AddDefine(const std::string& source, const std::string& name) {
+    // Insert after `#version` line
+    const size_t pos = source.find('\n') + 1;
+    return source.substr(0, pos) + "#define " + name + "\n" +
+           source.substr(pos);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// -------------------------------- Queue Family -------------------------------
+// -----------------------------------------------------------------------------
+uint32_t GetGraphicsQueueFamilyIdx(const vk::PhysicalDevice& physical_device) {
+    const auto queue_props = physical_device.getQueueFamilyProperties();
+    for (uint32_t i = 0; i < queue_props.size(); i++) {
+        if (queue_props[i].queueFlags & vk::QueueFlagBits::eGraphics) {
+            return i;
+        }
+    }
+    throw std::runtime_error("No graphics queue family is found");
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Pipeline Cache ------------------------------
+// -----------------------------------------------------------------------------
+bool IsCompatiblePipelineCache(const std::vector<uint8_t>& data,
+                               const vk::PhysicalDeviceProperties& props) {
+    // Check `VkPipelineCacheHeaderVersionOne` (drivers may not)
+    const size_t HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < HEADER_SIZE) {
+        return false;
+    }
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    return HEADER_SIZE <= header[0] &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == props.vendorID && header[3] == props.deviceID &&
+           std::memcmp(data.data() + sizeof(header),
+                       &props.pipelineCacheUUID[0], VK_UUID_SIZE) == 0;
+}
+
+vk::UniquePipelineCache LoadPipelineCache(
+        const vk::UniqueDevice& device,
+        const vk::PhysicalDevice& physical_device,
+        const std::string& filename) {
+    // Read blob (starts empty when missing or of another device/driver)
+    std::vector<uint8_t> data;
+    if (!filename.empty()) {
+        std::ifstream ifs(filename, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(ifs),
+                    std::istreambuf_iterator<char>());
+        if (!IsCompatiblePipelineCache(data,
+                                       physical_device.getProperties())) {
+            data.clear();
+        }
+    }
+    return device->createPipelineCacheUnique(
+            {vk::PipelineCacheCreateFlags(), data.size(), data.data()});
+}
+
+void SavePipelineCache(const vk::UniqueDevice& device,
+                       const vk::UniquePipelineCache& cache,
+                       const std::string& filename) {
+    if (filename.empty()) {
+        return;
+    }
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const fs::path dirname = fs::path(filename).parent_path();
+    if (!dirname.empty()) {
+        fs::create_directories(dirname, ec);
+    }
+
+    // Write to temporary file, then replace
+    const std::vector<uint8_t>& data = device->getPipelineCacheData(*cache);
+    const std::string tmp_filename = GetTempFilename(filename);
+    {
+        std::ofstream ofs(tmp_filename, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char*>(data.data()),
+                  static_cast<std::streamsize>(data.size()));
+        if (!ofs) {
+            Log(LogLevel::WARN, "Pipeline cache is not saved: ", filename);
+            fs::remove(tmp_filename, ec);
+            return;
+        }
+    }
+    fs::rename(tmp_filename, filename, ec);
+    if (ec) {
+        Log(LogLevel::WARN, "Pipeline cache is not saved: ", filename, " (",
+            ec.message(), ")");
+        fs::remove(tmp_filename, ec);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Render Context ------------------------------
+// -----------------------------------------------------------------------------
+std::string GetDefaultPipelineCachePath() {
+    namespace fs = std::filesystem;
+    fs::path cache_dir;
+#ifdef _WIN32
+    const char* local_app_data = std::getenv("LOCALAPPDATA");
+    if (local_app_data && *local_app_data) {
+        cache_dir = local_app_data;
+    }
+#else
+    const char* xdg_cache_home = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (xdg_cache_home && *xdg_cache_home) {
+        cache_dir = xdg_cache_home;
+    } else if (home && *home) {
+        cache_dir = fs::path(home) / ".cache";
+    }
+#endif
+    if (cache_dir.empty()) {
+        return "";
+    }
+    return (cache_dir / "facelmk3d" / "pipeline_cache.bin").string();
+}
+
+std::shared_ptr<RenderContext> RenderContext::Create(
+        const vkw::WindowPtr& window, const std::string& pipeline_cache_path) {
+    auto ctx = std::shared_ptr<RenderContext>(new RenderContext);
+    ctx->m_window = window;
+
+    // Create instance (without surface extensions for offscreen)
+    const bool DISPLAY_ENABLE = (window != nullptr);
+    const bool DEBUG_ENABLE = true;
+    ctx->m_instance =
+            vkw::CreateInstance("", 1, "", 0, DEBUG_ENABLE, DISPLAY_ENABLE);
+    // Get a physical_device
+    ctx->m_physical_device = vkw::GetFirstPhysicalDevice(ctx->m_instance);
+    if (DISPLAY_ENABLE) {
+        // Create surface
+        ctx->m_surface = vkw::CreateSurface(ctx->m_instance, window);
+        ctx->m_surface_format =
+                vkw::GetSurfaceFormat(ctx->m_physical_device, ctx->m_surface);
+        // Select queue family
+        ctx->m_queue_family_idx = vkw::GetGraphicPresentQueueFamilyIdx(
+                ctx->m_physical_device, ctx->m_surface);
+    } else {
+        // Select queue family (graphics only)
+        ctx->m_queue_family_idx =
+                GetGraphicsQueueFamilyIdx(ctx->m_physical_device);
+    }
+    // Create device (`gl_PrimitiveID` in fragment shader needs geometry)
+    const bool ID_ENABLE =
+            ctx->m_physical_device.getFeatures().geometryShader;
+    if (!ID_ENABLE) {
+        Log(LogLevel::INFO, "Geometry shader feature is not supported "
+                            "(vertex indices are found on CPU)");
+    }
+    vk::PhysicalDeviceFeatures features;
+    features.geometryShader = ID_ENABLE;
+    const uint32_t N_QUEUES = 1;
+    ctx->m_device = vkw::CreateDevice(ctx->m_queue_family_idx,
+                                      ctx->m_physical_device, N_QUEUES,
+                                      DISPLAY_ENABLE, features);
+    // Get queue
+    ctx->m_queue = vkw::GetQueue(ctx->m_device, ctx->m_queue_family_idx, 0);
+
+    // Create shaders
+#ifdef FACELMK3D_SPIRV
+    // Precompiled at build time
+    ctx->m_vert_shader = CreateShader(ctx->m_device, RENDER_VERT_SPV,
+                                      sizeof(RENDER_VERT_SPV),
+                                      vk::ShaderStageFlagBits::eVertex);
+    if (DISPLAY_ENABLE) {
+        ctx->m_frag_shader = CreateShader(ctx->m_device, RENDER_FRAG_WINDOW_SPV,
+                                          sizeof(RENDER_FRAG_WINDOW_SPV),
+                                          vk::ShaderStageFlagBits::eFragment);
+        if (ID_ENABLE) {
+            ctx->m_frag_id_shader = CreateShader(
+                    ctx->m_device, RENDER_FRAG_WINDOW_ID_SPV,
+                    sizeof(RENDER_FRAG_WINDOW_ID_SPV),
+                    vk::ShaderStageFlagBits::eFragment);
+        }
+    } else {
+        ctx->m_frag_shader = CreateShader(ctx->m_device, RENDER_FRAG_SPV,
+                                          sizeof(RENDER_FRAG_SPV),
+                                          vk::ShaderStageFlagBits::eFragment);
+        if (ID_ENABLE) {
+            ctx->m_frag_id_shader = CreateShader(
+                    ctx->m_device, RENDER_FRAG_ID_SPV,
+                    sizeof(RENDER_FRAG_ID_SPV),
+                    vk::ShaderStageFlagBits::eFragment);
+        }
+    }
+#else
+    // Compile embedded sources
+    vkw::GLSLCompiler glsl_compiler;
+    ctx->m_vert_shader = glsl_compiler.compileFromString(
+            ctx->m_device, RENDER_VERT_GLSL, vk::ShaderStageFlagBits::eVertex);
+    const std::string frag_source =
+            DISPLAY_ENABLE ? AddDefine(RENDER_FRAG_GLSL, "WINDOW_OUTPUT") :
+                             RENDER_FRAG_GLSL;
+    ctx->m_frag_shader = glsl_compiler.compileFromString(
+            ctx->m_device, frag_source, vk::ShaderStageFlagBits::eFragment);
+    if (ID_ENABLE) {
+        ctx->m_frag_id_shader = glsl_compiler.compileFromString(
+                ctx->m_device, AddDefine(frag_source, "ID_OUTPUT"),
+                vk::ShaderStageFlagBits::eFragment);
+    }
+#endif
+
+    // Load pipeline cache (saved at destruction when pipelines are created)
+    ctx->m_pipeline_cache_path = pipeline_cache_path;
+    ctx->m_pipeline_cache = LoadPipelineCache(
+            ctx->m_device, ctx->m_physical_device, pipeline_cache_path);
+    return ctx;
+}
+
+RenderContext::~RenderContext() {
+    // Once out of the pipeline lock, as renderers have released the context
+    if (!m_pipeline_cache_dirty) {
+        return;
+    }
+    try {
+        SavePipelineCache(m_device, m_pipeline_cache, m_pipeline_cache_path);
+    } catch (const std::exception& e) {
+        Log(LogLevel::WARN, "Pipeline cache is not saved: ", e.what());
+    }
+}
+
+const vkw::WindowPtr& RenderContext::getWindow() const {
+    return m_window;
+}
+
+const vk::PhysicalDevice& RenderContext::getPhysicalDevice() const {
+    return m_physical_device;
+}
+
+const vk::UniqueDevice& RenderContext::getDevice() const {
+    return m_device;
+}
+
+uint32_t RenderContext::getQueueFamilyIdx() const {
+    return m_queue_family_idx;
+}
+
+const vk::UniqueSurfaceKHR& RenderContext::getSurface() const {
+    return m_surface;
+}
+
+vk::Format RenderContext::getSurfaceFormat() const {
+    return m_surface_format;
+}
+
+bool RenderContext::supportsIdOutput() const {
+    return m_frag_id_shader != nullptr;
+}
+
+vkw::PipelinePackPtr RenderContext::getPipeline(vk::Format color_format,
+                                                SurfaceOutput output,
+                                                const CreatePipeline& create) {
+    if (output == SurfaceOutput::POS_ID && !supportsIdOutput()) {
+        throw std::runtime_error("Vertex index output is not supported");
+    }
+    std::lock_guard<std::mutex> lock(m_pipeline_mutex);
+    auto& pipeline = m_pipelines[{color_format, output}];
+    if (!pipeline) {
+        const auto& frag_shader = (output == SurfaceOutput::POS_ID) ?
+                                          m_frag_id_shader :
+                                          m_frag_shader;
+        pipeline = create(m_vert_shader, frag_shader, m_pipeline_cache);
+        m_pipeline_cache_dirty = true;
+    }
+    return pipeline;
+}
+
+void RenderContext::submit(const vk::UniqueCommandBuffer& cmd_buf,
+                           const vkw::FencePtr& fence,
+                           const vkw::SemaphorePtr& wait_semaphore) {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    if (wait_semaphore) {
+        vkw::QueueSubmit(m_queue, cmd_buf, fence,
+                         {{wait_semaphore,
+                           vk::PipelineStageFlagBits::eColorAttachmentOutput}},
+                         {});
+    } else {
+        vkw::QueueSubmit(m_queue, cmd_buf, fence, {}, {});
+    }
+}
+
+void RenderContext::present(const vkw::SwapchainPackPtr& swapchain,
+                            uint32_t img_idx) {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    vkw::QueuePresent(m_queue, swapchain, img_idx);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+#ifndef RENDER_CONTEXT_H_20210225
+#define RENDER_CONTEXT_H_20210225
+#include <vkw/vkw.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// -----------------------------------------------------------------------------
+// ------------------------------- Render Context ------------------------------
+// -----------------------------------------------------------------------------
+// Surface attachments written besides color
+enum class SurfaceOutput {
+    NONE,    // Color only (surface points are found on CPU)
+    POS,     // Position
+    POS_ID,  // Position and vertex index (needs `supportsIdOutput()`)
+};
+
+// Pipeline cache file in the user's cache directory (`$XDG_CACHE_HOME`,
+// `~/.cache` or `%LOCALAPPDATA%`). Empty when none is found.
+std::string GetDefaultPipelineCachePath();
+
+// Vulkan instance, device, queue, shaders and pipelines shared by renderers.
+// Renderers are lightweight sessions (e.g. one for each mesh or thread), which
+// keep only their buffers, images and command buffers. All methods are
+// thread-safe.
+class RenderContext {
+public:
+    // Offscreen context, or for drawing to the window. The pipeline cache file
+    // is kept between runs (empty to disable).
+    static std::shared_ptr<RenderContext> Create(
+            const vkw::WindowPtr& window = nullptr,
+            const std::string& pipeline_cache_path =
+                    GetDefaultPipelineCachePath());
+    ~RenderContext();  // Saves the pipeline cache
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+
+    const vkw::WindowPtr& getWindow() const;
+    const vk::PhysicalDevice& getPhysicalDevice() const;
+    const vk::UniqueDevice& getDevice() const;
+    uint32_t getQueueFamilyIdx() const;
+    const vk::UniqueSurfaceKHR& getSurface() const;  // Null without window
+    vk::Format getSurfaceFormat() const;
+    // Vertex index output uses `gl_PrimitiveID`, which needs the geometry
+    // shader feature. Without it, vertex indices are found on CPU.
+    bool supportsIdOutput() const;
+
+    // Pipelines are created once for each color format and output with
+    // `create`, and shared by renderers (their render passes and descriptor
+    // set layouts are compatible). The fragment shader is of the output.
+    using CreatePipeline = std::function<vkw::PipelinePackPtr(
+            const vkw::ShaderModulePackPtr& vert_shader,
+            const vkw::ShaderModulePackPtr& frag_shader,
+            const vk::UniquePipelineCache& pipeline_cache)>;
+    vkw::PipelinePackPtr getPipeline(vk::Format color_format,
+                                     SurfaceOutput output,
+                                     const CreatePipeline& create);
+
+    // Queue operations (the queue is used by renderers of any thread).
+    // `wait_semaphore` is waited before the color output when given.
+    void submit(const vk::UniqueCommandBuffer& cmd_buf,
+                const vkw::FencePtr& fence,
+                const vkw::SemaphorePtr& wait_semaphore = nullptr);
+    void present(const vkw::SwapchainPackPtr& swapchain, uint32_t img_idx);
+
+private:
+    RenderContext() = default;
+
+    vkw::WindowPtr m_window;
+    vk::UniqueInstance m_instance;
+    vk::PhysicalDevice m_physical_device;
+    vk::UniqueSurfaceKHR m_surface;
+    vk::Format m_surface_format;
+    uint32_t m_queue_family_idx = 0;
+    vk::UniqueDevice m_device;
+    vkw::ShaderModulePackPtr m_vert_shader;
+    vkw::ShaderModulePackPtr m_frag_shader;
+    vkw::ShaderModulePackPtr m_frag_id_shader;  // Null without support
+
+    std::mutex m_queue_mutex;
+    vk::Queue m_queue;
+
+    std::mutex m_pipeline_mutex;
+    std::string m_pipeline_cache_path;
+    vk::UniquePipelineCache m_pipeline_cache;
+    bool m_pipeline_cache_dirty = false;  // Pipelines are created
+    std::map<std::pair<vk::Format, SurfaceOutput>, vkw::PipelinePackPtr>
+            m_pipelines;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
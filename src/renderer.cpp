@@ -4,6 +4,18 @@ BEGIN_VKW_SUPPRESS_WARNING
 #include <tinyobjloader/tiny_obj_loader.h>
 END_VKW_SUPPRESS_WARNING
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "log.h"
+#include "mesh_cache.h"
+#include "profiler.h"
+
 namespace {
 
 // -----------------------------------------------------------------------------
@@ -13,7 +25,46 @@ std::string ExtractDirname(const std::string& path) {
     return path.substr(0, path.find_last_of('/') + 1);
 }
 
-Mesh LoadObj(const std::string& filename) {
+void BuildSearchStructures(Mesh& mesh) {
+    // Unique positions of referenced vertices (ascending `vtx_idx`)
+    uint32_t n_idxs = 0;
+    for (auto&& vtx : mesh.vertices) {
+        n_idxs = std::max(n_idxs, vtx.vtx_idx + 1);
+    }
+    std::vector<bool> vtx_used(n_idxs, false);
+    std::vector<glm::vec3> idx_poses(n_idxs);
+    for (auto&& vtx : mesh.vertices) {
+        vtx_used[vtx.vtx_idx] = true;
+        idx_poses[vtx.vtx_idx] = vtx.pos;
+    }
+    std::vector<glm::vec3> uniq_poses;
+    std::vector<uint32_t> uniq_idxs;
+    for (uint32_t vtx_idx = 0; vtx_idx < n_idxs; vtx_idx++) {
+        if (vtx_used[vtx_idx]) {
+            uniq_poses.push_back(idx_poses[vtx_idx]);
+            uniq_idxs.push_back(vtx_idx);
+        }
+    }
+
+    // Positions for ray casting structure over triangles
+    std::vector<glm::vec3> poses;
+    poses.reserve(mesh.vertices.size());
+    for (auto&& vtx : mesh.vertices) {
+        poses.push_back(vtx.pos);
+    }
+
+    // Build both in parallel
+    GetThreadPool().parallelFor(2, [&](uint32_t job_idx) {
+        if (job_idx == 0) {
+            mesh.vtx_tree.build(uniq_poses, uniq_idxs);
+        } else {
+            mesh.tri_bvh.build(poses, mesh.indices);
+        }
+    });
+}
+
+Mesh LoadObj(const std::string& filename, std::string& tex_filename,
+             FileStamp& tex_stamp) {
     const std::string& dirname = ExtractDirname(filename);
 
     // Load with tiny obj
@@ -30,11 +81,22 @@ Mesh LoadObj(const std::string& filename) {
     const std::vector<tinyobj::real_t>& tiny_vertices = tiny_attrib.vertices;
     const std::vector<tinyobj::real_t>& tiny_texcoords = tiny_attrib.texcoords;
 
-    // Parse to mesh structure
+    // Parse to mesh structure (deduplicate by position and uv indices)
     Mesh ret_mesh;
+    std::unordered_map<uint64_t, uint32_t> uniq_map;
     for (const tinyobj::shape_t& tiny_shape : tiny_shapes) {
         const tinyobj::mesh_t& tiny_mesh = tiny_shape.mesh;
         for (const tinyobj::index_t& tiny_idx : tiny_mesh.indices) {
+            // Look up registered one
+            const uint64_t key =
+                    (static_cast<uint64_t>(tiny_idx.vertex_index + 1) << 32) |
+                    static_cast<uint32_t>(tiny_idx.texcoord_index + 1);
+            const auto uniq_it = uniq_map.find(key);
+            if (uniq_it != uniq_map.end()) {
+                ret_mesh.indices.push_back(uniq_it->second);
+                continue;
+            }
+
             // Parse one vertex
             Vertex ret_vtx = {};
             if (0 <= tiny_idx.vertex_index) {
@@ -52,325 +114,1058 @@ Mesh LoadObj(const std::string& filename) {
                               tiny_texcoords[idx0 + 1]};
             }
             // Register
+            const auto new_idx =
+                    static_cast<uint32_t>(ret_mesh.vertices.size());
+            uniq_map.emplace(key, new_idx);
+            ret_mesh.indices.push_back(new_idx);
             ret_mesh.vertices.push_back(std::move(ret_vtx));
         }
     }
 
-    // Load textures
+    // Bounding box
+    ret_mesh.min_pos = glm::vec3(std::numeric_limits<float>::max());
+    ret_mesh.max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+    for (auto&& vtx : ret_mesh.vertices) {
+        ret_mesh.min_pos = glm::min(ret_mesh.min_pos, vtx.pos);
+        ret_mesh.max_pos = glm::max(ret_mesh.max_pos, vtx.pos);
+    }
+
+    // Check textures
     const auto& tiny_mats = obj_reader.GetMaterials();
     if (tiny_mats.empty()) {
-        std::cout << "Empty texture is not supported" << std::endl;
         throw std::runtime_error("Empty texture is not supported");
     }
     if (1 < tiny_mats.size()) {
-        std::cout << "Multiple textures are not supported" << std::endl;
         throw std::runtime_error("Multiple textures are not supported");
     }
     // Supports only 1 materials
     const tinyobj::material_t tiny_mat = tiny_mats[0];
-    // Load color texture
-    ret_mesh.color_tex = LoadImage(dirname + tiny_mat.diffuse_texname, 4);
+    tex_filename = dirname + tiny_mat.diffuse_texname;
+    if (!GetFileStamp(tex_filename, tex_stamp)) {
+        throw std::runtime_error("Failed to open texture: " + tex_filename);
+    }
+
+    // Decode color texture while building search structures
+    GetThreadPool().parallelFor(2, [&](uint32_t job_idx) {
+        if (job_idx == 0) {
+            auto tex = std::make_shared<ByteImage>(LoadImage(tex_filename, 4));
+            ret_mesh.color_tex = GetView(*tex);
+            ret_mesh.color_tex_owner = std::move(tex);
+        } else {
+            BuildSearchStructures(ret_mesh);
+        }
+    });
 
     return ret_mesh;
 }
 
 // -----------------------------------------------------------------------------
-// ---------------------------------- Shaders ----------------------------------
+// ------------------------------ Constant Values ------------------------------
 // -----------------------------------------------------------------------------
-const std::string VERT_SOURCE = R"(
-#version 460
+// Attachment formats
+const auto POS_FORMAT = vk::Format::eR32G32B32A32Sfloat;
+const auto ID_FORMAT = vk::Format::eR32Uint;
+const auto DEPTH_FORMAT = vk::Format::eD32Sfloat;
+// Views in a batch target (bounds memory of targets besides device limits)
+const uint32_t MAX_BATCH_TILES = 16;
+// Completed draws kept until waited (older ones are dropped, e.g. of callers
+// which never wait after an exception)
+const size_t MAX_STORED_DRAWS = 32;
 
-layout(binding = 0) uniform UniformBuffer {
-    mat4 mvp_mat;
-} uniform_buf;
-
-layout (location = 0) in vec3 pos;
-layout (location = 1) in vec2 uv;
-
-layout (location = 0) out vec3 vtx_pos;
-layout (location = 1) out vec2 vtx_uv;
+vk::Format GetVkFormat(ColorFormat color_format) {
+    if (color_format == ColorFormat::RGBA8) {
+        return vk::Format::eR8G8B8A8Unorm;
+    }
+    return vk::Format::eR32G32B32A32Sfloat;
+}
 
-void main() {
-    gl_Position = uniform_buf.mvp_mat * vec4(pos, 1.0);
-    vtx_pos = pos;
-    vtx_uv = uv;
+inline uint8_t CastUint(float v) {
+    return static_cast<uint8_t>(std::min(std::max(v * 255.f, 0.f), 255.f));
 }
-)";
 
-const std::string FRAG_SOURCE = R"(
-#version 460
+uint32_t FindNearestCorner(const Mesh& mesh, uint32_t tri_idx,
+                           const glm::vec3& pos) {
+    // Same rule as the fragment shader and the software rasterizer
+    uint32_t vtx_idx = INVALID_VTX_IDX;
+    float min_dist = std::numeric_limits<float>::max();
+    for (uint32_t k = 0; k < 3; k++) {
+        const Vertex& vtx = mesh.vertices[mesh.indices[tri_idx * 3 + k]];
+        const float dist = glm::distance(vtx.pos, pos);
+        if (dist < min_dist) {
+            min_dist = dist;
+            vtx_idx = vtx.vtx_idx;
+        }
+    }
+    return vtx_idx;
+}
 
-layout (binding = 1) uniform sampler2D tex;
+SurfacePoint CastRay(const Mesh& mesh, const glm::mat4& inv_mvpc_mat,
+                     const glm::vec2& ndc) {
+    // Ray from near to far plane (clip depth is in [0, 1])
+    const glm::vec4 near_h = inv_mvpc_mat * glm::vec4(ndc, 0.f, 1.f);
+    const glm::vec4 far_h = inv_mvpc_mat * glm::vec4(ndc, 1.f, 1.f);
+    const glm::vec3 near_pos = glm::vec3(near_h) / near_h.w;
+    const glm::vec3 far_pos = glm::vec3(far_h) / far_h.w;
+    const Bvh::Hit hit =
+            mesh.tri_bvh.intersect(near_pos, far_pos - near_pos, 1.f);
+    if (hit.tri_idx == Bvh::INVALID_ID) {
+        return {};  // Background
+    }
 
-layout (location = 0) in vec3 vtx_pos;
-layout (location = 1) in vec2 vtx_uv;
+    // Interpolate position
+    SurfacePoint ret;
+    for (uint32_t k = 0; k < 3; k++) {
+        const Vertex& vtx = mesh.vertices[mesh.indices[hit.tri_idx * 3 + k]];
+        ret.pos += hit.bary[static_cast<int>(k)] * vtx.pos;
+    }
+    ret.vtx_idx = FindNearestCorner(mesh, hit.tri_idx, ret.pos);
+    return ret;
+}
 
-layout (location = 0) out vec4 frag_window;
-layout (location = 1) out vec4 frag_color;
-layout (location = 2) out vec4 frag_pos;
+void ValidateNearestVertices(const Mesh& mesh,
+                             const std::vector<glm::vec3>& queries,
+                             const std::vector<uint32_t>& vtx_idxs) {
+    // Collect vertex positions with brute-force reference
+    std::vector<glm::vec3> poses, id_poses;
+    std::vector<uint32_t> ids;
+    for (auto&& vtx : mesh.vertices) {
+        poses.push_back(vtx.pos);
+        ids.push_back(vtx.vtx_idx);
+        if (id_poses.size() <= vtx.vtx_idx) {
+            id_poses.resize(vtx.vtx_idx + 1);
+        }
+        id_poses[vtx.vtx_idx] = vtx.pos;
+    }
 
-void main() {
-    vec2 uv = vec2(vtx_uv.x, 1.0 - vtx_uv.y);  // Y-flip
-    frag_color = texture(tex, uv);
-    frag_pos = vec4(vtx_pos, 1.0);
-    frag_window = frag_color;  // debug output
+    // Compare distances (indices may differ at ties)
+    for (size_t i = 0; i < queries.size(); i++) {
+        const uint32_t ref_idx = FindNearestBruteForce(poses, ids, queries[i]);
+        const float ref_dist = glm::distance(id_poses[ref_idx], queries[i]);
+        const float dist = glm::distance(id_poses[vtx_idxs[i]], queries[i]);
+        if (ref_dist != dist) {
+            throw std::runtime_error("Invalid nearest vertex search");
+        }
+    }
 }
-)";
+
+// -----------------------------------------------------------------------------
+// ---------------------------------- Shaders ----------------------------------
+// -----------------------------------------------------------------------------
+// Layout of `Vertex` assumed in `src/shaders/render.frag`
+static_assert(sizeof(Vertex) == 6 * 4 && offsetof(Vertex, pos) == 0 &&
+                      offsetof(Vertex, vtx_idx) == 5 * 4,
+              "Update VTX_WORDS and VTX_IDX_WORD in render.frag");
 
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 }  // namespace
 
+const glm::mat4 CLIP_MAT = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+                            0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.5f, 1.0f};
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Mesh Loader -------------------------------
+// -----------------------------------------------------------------------------
+uint64_t GenMeshId() {
+    static std::atomic<uint64_t> s_next_id{1};
+    return s_next_id++;
+}
+
+Mesh LoadMesh(const std::string& filename, bool use_cache) {
+    const std::string& cache_filename = GetMeshCachePath(filename);
+    Mesh mesh;
+    if (use_cache && LoadMeshCache(cache_filename, filename, mesh)) {
+        // Mapped from the cache
+        BuildSearchStructures(mesh);
+    } else {
+        // Parse OBJ and decode texture (stamped before reading)
+        FileStamp obj_stamp, tex_stamp;
+        const bool obj_stamped = GetFileStamp(filename, obj_stamp);
+        std::string tex_filename;
+        mesh = LoadObj(filename, tex_filename, tex_stamp);
+        if (use_cache) {
+            try {
+                if (!obj_stamped) {
+                    throw std::runtime_error("Failed to stat " + filename);
+                }
+                SaveMeshCache(cache_filename, obj_stamp, tex_filename,
+                              tex_stamp, mesh);
+            } catch (const std::exception& e) {
+                Log(LogLevel::WARN, "Mesh cache is not saved: ", e.what());
+            }
+        }
+    }
+    return mesh;
+}
+
 // -----------------------------------------------------------------------------
-// ----------------------- 3D Renderer by Vulkan Backend -----------------------
+// --------------------------------- 3D Renderer -------------------------------
 // -----------------------------------------------------------------------------
-Renderer::Renderer(const vkw::WindowPtr& window) {
+Renderer::Renderer(const vkw::WindowPtr& window, RenderBackend backend)
+    : m_backend(backend) {
     m_window = window;
+    int w_tmp, h_tmp;
+    glfwGetFramebufferSize(m_window.get(), &w_tmp, &h_tmp);
+    m_width = static_cast<uint32_t>(w_tmp);
+    m_height = static_cast<uint32_t>(h_tmp);
+}
+
+Renderer::Renderer(uint32_t width, uint32_t height, RenderBackend backend)
+    : m_backend(backend), m_width(width), m_height(height) {}
+
+Renderer::Renderer(std::shared_ptr<RenderContext> context, uint32_t width,
+                   uint32_t height)
+    : m_backend(RenderBackend::VULKAN),
+      m_width(width),
+      m_height(height),
+      m_window(context->getWindow()),
+      m_context(std::move(context)) {}
+
+Renderer::~Renderer() {
+    // Resources may be still in use on the shared device
+    for (auto&& slot : m_frames) {
+        if (slot.pending && slot.fence) {
+            vkw::WaitForFences(m_context->getDevice(), {slot.fence});
+        }
+    }
 }
 
-void Renderer::loadObj(const std::string& filename) {
-    m_mesh = LoadObj(filename);
+void Renderer::loadObj(const std::string& filename, bool use_cache) {
+    setMesh(std::make_shared<const Mesh>(LoadMesh(filename, use_cache)));
+}
+
+void Renderer::setMesh(std::shared_ptr<const Mesh> mesh) {
+    if (m_mesh == mesh) {
+        return;  // Keep uploaded buffers
+    }
+    m_mesh = std::move(mesh);
     m_inited = false;
 }
 
 const Mesh& Renderer::getMesh() const {
+    return *m_mesh;
+}
+
+std::shared_ptr<const Mesh> Renderer::getMeshPtr() const {
     return m_mesh;
 }
 
+RenderBackend Renderer::getBackend() const {
+    return m_backend;
+}
+
+std::shared_ptr<RenderContext> Renderer::getContext() const {
+    return m_context;
+}
+
+void Renderer::setFramesInFlight(uint32_t n_frames) {
+    n_frames = std::max(n_frames, 1u);
+    if (m_n_frames == n_frames) {
+        return;
+    }
+    m_n_frames = n_frames;
+    m_inited = false;
+}
+
+void Renderer::setColorFormat(ColorFormat color_format) {
+    if (m_color_format == color_format) {
+        return;
+    }
+    m_color_format = color_format;
+    m_inited = false;
+}
+
+void Renderer::setDenseReadback(bool enabled) {
+    if (m_dense_readback == enabled) {
+        return;
+    }
+    m_dense_readback = enabled;
+    m_inited = false;
+}
+
+void Renderer::setPipelineCachePath(const std::string& filename) {
+    m_pipeline_cache_path = filename;
+}
+
 std::tuple<FloatImage, FloatImage> Renderer::draw(const glm::mat4& mvp_mat) {
+    return waitDraw(submitDraw(mvp_mat));
+}
+
+DrawTicket Renderer::submitDraw(const glm::mat4& mvp_mat) {
+    ProfileZone zone("Renderer::submitDraw");
+    glm::mat4 mvpc_mat = CLIP_MAT * mvp_mat;
+
     // Initialize once
     if (!m_inited) {
         m_inited = true;
         init();
     }
 
-    // Send matrix to uniform buffer
-    const glm::mat4 CLIP_MAT = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-                                0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f,
-                                0.0f, 0.0f, 0.5f, 1.0f};
-    glm::mat4 mvpc_mat = CLIP_MAT * mvp_mat;
-    vkw::SendToDevice(m_device, m_uniform_buf, &mvpc_mat[0], sizeof(glm::mat4));
-
-    // Acquire screen frame
-    auto img_acquired_semaphore = vkw::CreateSemaphore(m_device);
-    uint32_t curr_img_idx = vkw::AcquireNextImage(
-            m_device, m_swapchain, img_acquired_semaphore, nullptr);
-
-    // Draw
-    auto draw_fence = vkw::CreateFence(m_device);
-    vkw::QueueSubmit(m_queue, m_cmd_bufs->cmd_bufs[curr_img_idx], draw_fence,
-                     {{img_acquired_semaphore,
-                       vk::PipelineStageFlagBits::eColorAttachmentOutput}},
-                     {});
-    vkw::QueuePresent(m_queue, m_swapchain, curr_img_idx);
-    vkw::WaitForFences(m_device, {draw_fence});
-
-    // Receive rendered image
-    const auto img_w = m_swapchain->size.width;
-    const auto img_h = m_swapchain->size.height;
-    FloatImage col_img = CreateImage(img_w, img_h, 4);
-    FloatImage pos_img = CreateImage(img_w, img_h, 4);
-    vkw::RecvFromDevice(m_device, m_color_recv_buf, col_img.pixels.data(),
-                        col_img.pixels.size() * sizeof(float));
-    vkw::RecvFromDevice(m_device, m_pos_recv_buf, pos_img.pixels.data(),
-                        pos_img.pixels.size() * sizeof(float));
+    // Complete the oldest draw when its frame slot is still in use
+    const DrawTicket ticket = m_next_ticket++;
+    const uint32_t slot_idx = static_cast<uint32_t>(ticket % m_n_frames);
+    FrameSlot& slot = m_frames[slot_idx];
+    if (slot.pending) {
+        complete(slot);
+        ProfileZone readback_zone("Renderer::readback");
+        const size_t n_pixs = m_width * m_height;
+        const auto color_ptr = static_cast<const uint8_t*>(slot.color_ptr);
+        while (MAX_STORED_DRAWS <= m_done_draws.size()) {
+            m_done_draws.erase(m_done_draws.begin());  // Oldest ticket
+        }
+        StoredDraw& stored = m_done_draws[slot.ticket];
+        stored.color.assign(color_ptr, color_ptr + n_pixs * getColorBytes());
+        if (m_dense_readback) {
+            stored.pos.assign(slot.pos_ptr, slot.pos_ptr + n_pixs * 4);
+        }
+        if (m_dense_readback && m_id_output) {
+            stored.id.assign(slot.id_ptr, slot.id_ptr + n_pixs);
+        }
+        stored.mvpc_mat = slot.mvpc_mat;
+    }
+    slot.ticket = ticket;
+    slot.pending = true;
+    slot.mvpc_mat = mvpc_mat;
+
+    // Render by CPU
+    if (m_backend == RenderBackend::CPU) {
+        ProfileZone raster_zone("SoftRasterizer::draw");
+        auto&& col_pos_imgs =
+                m_soft_rasterizer.draw(*m_mesh, mvpc_mat, m_width, m_height);
+        const auto& col_pixs = std::get<0>(col_pos_imgs).pixels;
+        if (m_color_format == ColorFormat::RGBA8) {
+            slot.cpu_color.resize(col_pixs.size());
+            std::transform(col_pixs.begin(), col_pixs.end(),
+                           slot.cpu_color.begin(), CastUint);
+        } else {
+            const auto col_bytes =
+                    reinterpret_cast<const uint8_t*>(col_pixs.data());
+            slot.cpu_color.assign(col_bytes,
+                                  col_bytes + col_pixs.size() * sizeof(float));
+        }
+        slot.cpu_pos = std::move(std::get<1>(col_pos_imgs).pixels);
+        slot.cpu_id = std::move(std::get<2>(col_pos_imgs));
+        slot.color_ptr = slot.cpu_color.data();
+        slot.pos_ptr = slot.cpu_pos.data();
+        slot.id_ptr = slot.cpu_id.data();
+        return ticket;
+    }
+
+    // Send matrix to uniform buffer of the slot
+    const vk::UniqueDevice& device = m_context->getDevice();
+    vkw::SendToDevice(device, slot.uniform_buf, &mvpc_mat[0],
+                      sizeof(glm::mat4));
+
+    slot.fence = vkw::CreateFence(device);
+    slot.gpu_timed = m_query_pool && IsProfiling();
+    slot.submit_ns = GetProfileTimeNs();
+    if (m_window) {
+        // Acquire screen frame
+        slot.img_acquired_semaphore = vkw::CreateSemaphore(device);
+        uint32_t curr_img_idx = vkw::AcquireNextImage(
+                device, m_swapchain, slot.img_acquired_semaphore, nullptr);
+
+        // Draw
+        recordDraw(slot_idx, &slot, 1, curr_img_idx);
+        m_context->submit(m_cmd_bufs->cmd_bufs[slot_idx], slot.fence,
+                          slot.img_acquired_semaphore);
+        m_context->present(m_swapchain, curr_img_idx);
+    } else {
+        // Draw (offscreen)
+        recordDraw(slot_idx, &slot, 1, 0);
+        m_context->submit(m_cmd_bufs->cmd_bufs[slot_idx], slot.fence);
+    }
+
+    return ticket;
+}
+
+std::vector<DrawTicket> Renderer::submitDraws(
+        const std::vector<glm::mat4>& mvp_mats) {
+    std::vector<DrawTicket> tickets;
+    for (auto&& mvp_mat : mvp_mats) {
+        tickets.push_back(submitDraw(mvp_mat));
+    }
+    return tickets;
+}
+
+std::tuple<FloatImage, FloatImage> Renderer::waitDraw(DrawTicket ticket) {
+    const FrameView view = waitDrawView(ticket);
+
+    // Copy to owned images
+    ProfileZone zone("Renderer::readback");
+    FloatImage col_img = CreateImage(m_width, m_height, 4);
+    FloatImage pos_img = CreateImage(m_width, m_height, 4);
+    const size_t n_elems = col_img.pixels.size();
+    if (!view.color.empty()) {
+        std::transform(view.color.pixels, view.color.pixels + n_elems,
+                       col_img.pixels.begin(),
+                       [](uint8_t v) { return v / 255.f; });
+    } else {
+        std::copy(view.color_f.pixels, view.color_f.pixels + n_elems,
+                  col_img.pixels.begin());
+    }
+    if (!view.pos.empty()) {
+        std::copy(view.pos.pixels, view.pos.pixels + n_elems,
+                  pos_img.pixels.begin());
+    }
 
     return std::make_tuple(std::move(col_img), std::move(pos_img));
 }
 
+FrameView Renderer::waitDrawView(DrawTicket ticket) {
+    // Already completed to reuse its frame slot
+    auto done_it = m_done_draws.find(ticket);
+    if (done_it != m_done_draws.end()) {
+        m_viewed_draw = std::move(done_it->second);
+        m_done_draws.erase(done_it);
+        return makeFrameView(m_viewed_draw.color.data(),
+                             m_viewed_draw.pos.data(), m_viewed_draw.id.data(),
+                             m_viewed_draw.mvpc_mat);
+    }
+
+    // Still in flight
+    if (m_inited && !m_frames.empty()) {
+        FrameSlot& slot = m_frames[ticket % m_n_frames];
+        if (slot.pending && slot.ticket == ticket) {
+            complete(slot);
+            return makeFrameView(slot.color_ptr, slot.pos_ptr, slot.id_ptr,
+                                 slot.mvpc_mat);
+        }
+    }
+    throw std::runtime_error(
+            "Invalid, already received or dropped draw ticket");
+}
+
+std::vector<FrameView> Renderer::drawBatchViews(
+        const std::vector<glm::mat4>& mvp_mats) {
+    ProfileZone zone("Renderer::drawBatch");
+    const auto n_views = static_cast<uint32_t>(mvp_mats.size());
+    if (n_views == 0) {
+        return {};
+    }
+
+    // Initialize once
+    if (!m_inited) {
+        m_inited = true;
+        init();
+    }
+
+    // Draw one by one (tiles need an offscreen target), copied into one target
+    std::vector<FrameView> views;
+    if (m_backend == RenderBackend::CPU || m_window) {
+        m_batch_targets.resize(1);
+        FrameSlot& target = m_batch_targets[0];
+        target.cpu_color.clear();
+        target.cpu_pos.clear();
+        target.cpu_id.clear();
+        std::vector<glm::mat4> mvpc_mats;
+        for (auto&& mvp_mat : mvp_mats) {
+            const FrameView view = waitDrawView(submitDraw(mvp_mat));
+            const auto color_ptr = view.color.empty() ?
+                    reinterpret_cast<const uint8_t*>(view.color_f.pixels) :
+                    view.color.pixels;
+            const size_t n_pixs = size_t(m_width) * m_height;
+            target.cpu_color.insert(target.cpu_color.end(), color_ptr,
+                                    color_ptr + n_pixs * getColorBytes());
+            if (m_dense_readback) {
+                target.cpu_pos.insert(target.cpu_pos.end(), view.pos.pixels,
+                                      view.pos.pixels + n_pixs * 4);
+            }
+            if (m_dense_readback && m_id_output) {
+                target.cpu_id.insert(target.cpu_id.end(), view.id.pixels,
+                                     view.id.pixels + n_pixs);
+            }
+            mvpc_mats.push_back(view.mvpc_mat);
+        }
+        target.n_tiles = n_views;
+        target.color_ptr = target.cpu_color.data();
+        target.pos_ptr = target.cpu_pos.data();
+        target.id_ptr = target.cpu_id.data();
+        for (uint32_t view_idx = 0; view_idx < n_views; view_idx++) {
+            views.push_back(
+                    makeTileView(target, view_idx, mvpc_mats[view_idx]));
+        }
+        return views;
+    }
+
+    // Targets of tiles (recreated when too few or too small)
+    const uint32_t n_target_tiles =
+            m_batch_targets.empty() ? 0 : m_batch_targets[0].n_tiles;
+    if (n_target_tiles < std::min(n_views, m_max_tiles) ||
+        n_target_tiles * m_batch_targets.size() < n_views) {
+        const uint32_t n_tiles = std::min(n_views, m_max_tiles);
+        m_batch_targets.clear();
+        m_batch_targets.resize((n_views + n_tiles - 1) / n_tiles);
+        for (auto&& target : m_batch_targets) {
+            target.cmd_idx = m_n_frames;  // Last command buffer
+            initFrameSlot(target, n_tiles);
+        }
+    }
+    const uint32_t n_tiles = m_batch_targets[0].n_tiles;
+
+    // Send matrices to uniform buffers (tiles are at dynamic offsets)
+    std::vector<glm::mat4> mvpc_mats;
+    for (auto&& mvp_mat : mvp_mats) {
+        mvpc_mats.push_back(CLIP_MAT * mvp_mat);
+    }
+    std::vector<uint8_t> uniform_data(size_t(m_uniform_stride) * n_tiles);
+    for (uint32_t view_idx = 0; view_idx < n_views; view_idx += n_tiles) {
+        const uint32_t n_target_views = std::min(n_tiles, n_views - view_idx);
+        for (uint32_t tile_idx = 0; tile_idx < n_target_views; tile_idx++) {
+            std::memcpy(&uniform_data[size_t(m_uniform_stride) * tile_idx],
+                        &mvpc_mats[view_idx + tile_idx][0],
+                        sizeof(glm::mat4));
+        }
+        vkw::SendToDevice(m_context->getDevice(),
+                          m_batch_targets[view_idx / n_tiles].uniform_buf,
+                          uniform_data.data(), uniform_data.size());
+    }
+
+    // Draw all targets with one submission
+    FrameSlot& head = m_batch_targets[0];
+    head.fence = vkw::CreateFence(m_context->getDevice());
+    head.gpu_timed = m_query_pool && IsProfiling();
+    head.submit_ns = GetProfileTimeNs();
+    head.pending = true;
+    recordDraw(m_n_frames, m_batch_targets.data(), n_views, 0);
+    m_context->submit(m_cmd_bufs->cmd_bufs[m_n_frames], head.fence);
+    complete(head);
+
+    for (uint32_t view_idx = 0; view_idx < n_views; view_idx++) {
+        views.push_back(makeTileView(m_batch_targets[view_idx / n_tiles],
+                                     view_idx % n_tiles, mvpc_mats[view_idx]));
+    }
+    return views;
+}
+
+void Renderer::complete(FrameSlot& slot) {
+    slot.pending = false;
+    if (m_backend != RenderBackend::VULKAN) {
+        return;
+    }
+
+    // Wait for the frame (received images are in mapped memory)
+    {
+        ProfileZone zone("Renderer::waitFence");
+        vkw::WaitForFences(m_context->getDevice(), {slot.fence});
+    }
+
+    // GPU time of the frame (placed at its submission on the trace)
+    if (slot.gpu_timed) {
+        const uint32_t query_idx = slot.cmd_idx * 2;
+        std::array<uint64_t, 2> stamps;
+        const vk::UniqueDevice& device = m_context->getDevice();
+        const vk::Result result = device->getQueryPoolResults(
+                m_query_pool.get(), query_idx, 2, sizeof(stamps),
+                stamps.data(), sizeof(uint64_t),
+                vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess) {
+            // Only valid bits are meaningful (wrapped at the width)
+            const uint64_t ticks =
+                    ((stamps[1] & m_timestamp_mask) -
+                     (stamps[0] & m_timestamp_mask)) &
+                    m_timestamp_mask;
+            const double dur_ns = double(ticks) * m_timestamp_period;
+            AddGpuProfileEvent((slot.cmd_idx == m_n_frames) ?
+                                       "Renderer::drawBatch" :
+                                       "Renderer::draw",
+                               slot.submit_ns, static_cast<int64_t>(dur_ns));
+        }
+    }
+}
+
+FrameView Renderer::makeFrameView(const void* color_ptr, const float* pos_ptr,
+                                  const uint32_t* id_ptr,
+                                  const glm::mat4& mvpc_mat) const {
+    FrameView view;
+    if (m_color_format == ColorFormat::RGBA8) {
+        view.color = {static_cast<const uint8_t*>(color_ptr), m_width,
+                      m_height, 4};
+    } else {
+        view.color_f = {static_cast<const float*>(color_ptr), m_width,
+                        m_height, 4};
+    }
+    if (m_dense_readback) {
+        view.pos = {pos_ptr, m_width, m_height, 4};
+    }
+    if (m_dense_readback && m_id_output) {
+        view.id = {id_ptr, m_width, m_height, 1};
+    }
+    view.mvpc_mat = mvpc_mat;
+    return view;
+}
+
+FrameView Renderer::makeTileView(const FrameSlot& slot, uint32_t tile_idx,
+                                 const glm::mat4& mvpc_mat) const {
+    // Tiles are contiguous, as they are stacked vertically
+    const size_t pix_offset = size_t(m_width) * m_height * tile_idx;
+    const auto color_ptr = static_cast<const uint8_t*>(slot.color_ptr) +
+                           pix_offset * getColorBytes();
+    if (!m_dense_readback) {
+        return makeFrameView(color_ptr, nullptr, nullptr, mvpc_mat);
+    }
+    return makeFrameView(color_ptr, slot.pos_ptr + pix_offset * 4,
+                         m_id_output ? slot.id_ptr + pix_offset : nullptr,
+                         mvpc_mat);
+}
+
+size_t Renderer::getColorBytes() const {
+    return (m_color_format == ColorFormat::RGBA8) ? 4 : sizeof(float) * 4;
+}
+
 void Renderer::init() {
-    // Create instance
-    const bool DISPLAY_ENABLE = true;
-    const bool DEBUG_ENABLE = true;
-    m_instance =
-            vkw::CreateInstance("", 1, "", 0, DEBUG_ENABLE, DISPLAY_ENABLE);
-    // Get a physical_device
-    m_physical_device = vkw::GetFirstPhysicalDevice(m_instance);
-    // Create surface
-    m_surface = vkw::CreateSurface(m_instance, m_window);
-    m_surface_format = vkw::GetSurfaceFormat(m_physical_device, m_surface);
-    // Select queue family
-    m_queue_family_idx =
-            vkw::GetGraphicPresentQueueFamilyIdx(m_physical_device, m_surface);
-    // Create device
-    const uint32_t N_QUEUES = 1;
-    m_device = vkw::CreateDevice(m_queue_family_idx, m_physical_device,
-                                 N_QUEUES, DISPLAY_ENABLE);
-    // Create swapchain
-    m_swapchain =
-            vkw::CreateSwapchainPack(m_physical_device, m_device, m_surface);
-    // Get queue
-    m_queue = vkw::GetQueue(m_device, m_queue_family_idx, 0);
-
-    // Create depth image
-    const auto COLOR_FORMAT = vk::Format::eR32G32B32A32Sfloat;
-    m_color_img = vkw::CreateImagePack(
-            m_physical_device, m_device, COLOR_FORMAT, m_swapchain->size, 1,
-            vk::ImageUsageFlagBits::eColorAttachment |
-                    vk::ImageUsageFlagBits::eTransferSrc,
-            {}, true);
-    m_pos_img = vkw::CreateImagePack(
-            m_physical_device, m_device, COLOR_FORMAT, m_swapchain->size, 1,
-            vk::ImageUsageFlagBits::eColorAttachment |
-                    vk::ImageUsageFlagBits::eTransferSrc,
-            {}, true);
-    const auto DEPTH_FORMAT = vk::Format::eD32Sfloat;
-    m_depth_img = vkw::CreateImagePack(
-            m_physical_device, m_device, DEPTH_FORMAT, m_swapchain->size, 1,
-            vk::ImageUsageFlagBits::eDepthStencilAttachment, {}, true,
-            vk::ImageAspectFlagBits::eDepth);
+    ProfileZone zone("Renderer::init");
+    // Frame slots (pending draws of the previous mesh are dropped)
+    for (auto&& slot : m_frames) {
+        if (slot.pending && slot.fence) {
+            vkw::WaitForFences(m_context->getDevice(), {slot.fence});
+        }
+    }
+    m_frames.clear();
+    m_frames.resize(m_n_frames);
+    m_batch_targets.clear();  // Batches are completed when drawn
+    m_done_draws.clear();
+    m_query_pool.reset();
+    m_id_output = true;  // Software rasterizer draws vertex indices
+    if (m_backend == RenderBackend::CPU) {
+        return;
+    }
+
+    // Device, shaders and pipelines are kept in the context
+    if (!m_context) {
+        m_context = RenderContext::Create(m_window, m_pipeline_cache_path);
+    }
+    const vk::PhysicalDevice& physical_device = m_context->getPhysicalDevice();
+    const vk::UniqueDevice& device = m_context->getDevice();
+    const uint32_t queue_family_idx = m_context->getQueueFamilyIdx();
+    const bool DISPLAY_ENABLE = (m_window != nullptr);
+    if (DISPLAY_ENABLE && !m_swapchain) {
+        // Create swapchain (its size overrides requested one)
+        m_swapchain = vkw::CreateSwapchainPack(physical_device, device,
+                                               m_context->getSurface());
+        m_width = m_swapchain->size.width;
+        m_height = m_swapchain->size.height;
+    }
+
+    // Create timestamp queries (two for each frame slot and batches) when
+    // supported
+    const vk::PhysicalDeviceLimits limits =
+            physical_device.getProperties().limits;
+    const auto queue_props = physical_device.getQueueFamilyProperties();
+    const uint32_t valid_bits =
+            queue_props[queue_family_idx].timestampValidBits;
+    if (0 < valid_bits) {
+        m_query_pool = device->createQueryPoolUnique(
+                {{}, vk::QueryType::eTimestamp, (m_n_frames + 1) * 2});
+        m_timestamp_period = limits.timestampPeriod;
+        m_timestamp_mask = (64 <= valid_bits) ? ~uint64_t(0) :
+                                                (uint64_t(1) << valid_bits) - 1;
+    }
+
+    // Tiles of batch targets (matrices at aligned dynamic offsets)
+    const auto align = static_cast<uint32_t>(std::max(
+            limits.minUniformBufferOffsetAlignment, vk::DeviceSize(1)));
+    m_uniform_stride =
+            (uint32_t(sizeof(glm::mat4)) + align - 1) / align * align;
+    const uint32_t max_height =
+            std::min(limits.maxImageDimension2D, limits.maxFramebufferHeight);
+    m_max_tiles = std::min(std::max(max_height / m_height, 1u),
+                           MAX_BATCH_TILES);
 
-    // Create uniform buffer
-    m_uniform_buf = vkw::CreateBufferPack(
-            m_physical_device, m_device, sizeof(glm::mat4),
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vkw::HOST_VISIB_COHER_PROPS);
     // Create color texture
     m_color_tex = vkw::CreateTexturePack(
             vkw::CreateImagePack(
-                    m_physical_device, m_device,
-                    vk::Format::eR32G32B32A32Sfloat,
-                    {m_mesh.color_tex.width, m_mesh.color_tex.height}, 1,
+                    physical_device, device, vk::Format::eR8G8B8A8Unorm,
+                    {m_mesh->color_tex.width, m_mesh->color_tex.height}, 1,
                     vk::ImageUsageFlagBits::eSampled |
                             vk::ImageUsageFlagBits::eTransferDst,
                     {}, true,  // tiling
                     vk::ImageAspectFlagBits::eColor),
-            m_device);
-
-    // Create descriptor set for uniform buffer and texture
-    m_desc_set = vkw::CreateDescriptorSetPack(
-            m_device, {{vk::DescriptorType::eUniformBufferDynamic, 1,
-                        vk::ShaderStageFlagBits::eVertex},
-                       {vk::DescriptorType::eCombinedImageSampler, 1,
-                        vk::ShaderStageFlagBits::eFragment}});
-    // Bind descriptor set with actual buffer
-    m_write_desc_set = vkw::CreateWriteDescSetPack();
-    vkw::AddWriteDescSet(m_write_desc_set, m_desc_set, 0, {m_uniform_buf});
-    vkw::AddWriteDescSet(m_write_desc_set, m_desc_set, 1,
-                         {m_color_tex},  // layout is still undefined.
-                         {vk::ImageLayout::eShaderReadOnlyOptimal});
-    vkw::UpdateDescriptorSets(m_device, m_write_desc_set);
+            device);
 
-    // Create render pass
+    // Create render pass (surface attachments only for dense readback, and
+    // vertex index attachment when the device supports)
+    m_id_output = m_dense_readback && m_context->supportsIdOutput();
     m_render_pass = vkw::CreateRenderPassPack();
-    // Add window attachment
-    vkw::AddAttachientDesc(
-            m_render_pass, m_surface_format, vk::AttachmentLoadOp::eClear,
-            vk::AttachmentStoreOp::eStore, vk::ImageLayout::ePresentSrcKHR);
+    std::vector<vkw::AttachmentIdx> color_refs;
+    auto add_color_attachment = [&](vk::Format format, vk::ImageLayout layout) {
+        vkw::AddAttachientDesc(m_render_pass, format,
+                               vk::AttachmentLoadOp::eClear,
+                               vk::AttachmentStoreOp::eStore, layout);
+        color_refs.emplace_back(static_cast<uint32_t>(color_refs.size()),
+                                vk::ImageLayout::eColorAttachmentOptimal);
+    };
+    if (DISPLAY_ENABLE) {
+        // Add window attachment
+        add_color_attachment(m_context->getSurfaceFormat(),
+                             vk::ImageLayout::ePresentSrcKHR);
+    }
     // Add color attachment
-    vkw::AddAttachientDesc(m_render_pass, COLOR_FORMAT,
-                           vk::AttachmentLoadOp::eClear,
-                           vk::AttachmentStoreOp::eStore,
-                           vk::ImageLayout::eColorAttachmentOptimal);
-    // Add position attachment
-    vkw::AddAttachientDesc(m_render_pass, COLOR_FORMAT,
-                           vk::AttachmentLoadOp::eClear,
-                           vk::AttachmentStoreOp::eStore,
-                           vk::ImageLayout::eColorAttachmentOptimal);
+    add_color_attachment(GetVkFormat(m_color_format),
+                         vk::ImageLayout::eColorAttachmentOptimal);
+    if (m_dense_readback) {
+        // Add position attachment
+        add_color_attachment(POS_FORMAT,
+                             vk::ImageLayout::eColorAttachmentOptimal);
+    }
+    if (m_id_output) {
+        // Add vertex index attachment
+        add_color_attachment(ID_FORMAT,
+                             vk::ImageLayout::eColorAttachmentOptimal);
+    }
     // Add depth attachment
     vkw::AddAttachientDesc(m_render_pass, DEPTH_FORMAT,
                            vk::AttachmentLoadOp::eClear,
                            vk::AttachmentStoreOp::eDontCare,
                            vk::ImageLayout::eDepthStencilAttachmentOptimal);
     // Add subpass
-    vkw::AddSubpassDesc(m_render_pass, {},
-                        {{0, vk::ImageLayout::eColorAttachmentOptimal},
-                         {1, vk::ImageLayout::eColorAttachmentOptimal},
-                         {2, vk::ImageLayout::eColorAttachmentOptimal}},
-                        {3, vk::ImageLayout::eDepthStencilAttachmentOptimal});
+    vkw::AddSubpassDesc(m_render_pass, {}, color_refs,
+                        {static_cast<uint32_t>(color_refs.size()),
+                         vk::ImageLayout::eDepthStencilAttachmentOptimal});
     // Create render pass instance
-    vkw::UpdateRenderPass(m_device, m_render_pass);
-
-    // Create frame buffers for swapchain images
-    m_framebuffers = vkw::CreateFrameBuffers(
-            m_device, m_render_pass,
-            {nullptr, m_color_img, m_pos_img, m_depth_img}, m_swapchain);
-
-    // Compile shaders
-    vkw::GLSLCompiler glsl_compiler;
-    m_vert_shader = glsl_compiler.compileFromString(
-            m_device, VERT_SOURCE, vk::ShaderStageFlagBits::eVertex);
-    m_frag_shader = glsl_compiler.compileFromString(
-            m_device, FRAG_SOURCE, vk::ShaderStageFlagBits::eFragment);
-
-    // Create vertex buffer
-    size_t vertex_buf_size = m_mesh.vertices.size() * sizeof(Vertex);
-    m_vtx_buf =
-            vkw::CreateBufferPack(m_physical_device, m_device, vertex_buf_size,
-                                  vk::BufferUsageFlagBits::eVertexBuffer,
-                                  vkw::HOST_VISIB_COHER_PROPS);
+    vkw::UpdateRenderPass(device, m_render_pass);
+
+    // Create vertex buffer (also read as storage buffer by fragment shader)
+    size_t vertex_buf_size = m_mesh->vertices.size() * sizeof(Vertex);
+    m_vtx_buf = vkw::CreateBufferPack(
+            physical_device, device, vertex_buf_size,
+            vk::BufferUsageFlagBits::eVertexBuffer |
+                    vk::BufferUsageFlagBits::eStorageBuffer,
+            vkw::HOST_VISIB_COHER_PROPS);
     // Send vertices to GPU
-    vkw::SendToDevice(m_device, m_vtx_buf, m_mesh.vertices.data(),
+    vkw::SendToDevice(device, m_vtx_buf, m_mesh->vertices.data(),
                       vertex_buf_size);
+    // Create index buffer
+    size_t index_buf_size = m_mesh->indices.size() * sizeof(uint32_t);
+    m_idx_buf = vkw::CreateBufferPack(
+            physical_device, device, index_buf_size,
+            vk::BufferUsageFlagBits::eIndexBuffer |
+                    vk::BufferUsageFlagBits::eStorageBuffer,
+            vkw::HOST_VISIB_COHER_PROPS);
+    // Send indices to GPU
+    vkw::SendToDevice(device, m_idx_buf, m_mesh->indices.data(),
+                      index_buf_size);
 
-    // Create pipeline
-    vkw::PipelineInfo pipeline_info;
-    pipeline_info.color_blend_infos.resize(3);
-    pipeline_info.face_culling = vk::CullModeFlagBits::eNone;
-    m_pipeline = vkw::CreateGraphicsPipeline(
-            m_device, {m_vert_shader, m_frag_shader},
-            {{0, sizeof(Vertex), vk::VertexInputRate::eVertex}},
-            {{0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos)},
-             {1, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, uv)}},
-            pipeline_info, {m_desc_set}, m_render_pass);
-
-    // Create command buffers
-    uint32_t n_cmd_bufs = static_cast<uint32_t>(m_framebuffers.size());
-    m_cmd_bufs = vkw::CreateCommandBuffersPack(m_device, m_queue_family_idx,
-                                               n_cmd_bufs);
+    // Create per-frame resources
+    for (uint32_t slot_idx = 0; slot_idx < m_n_frames; slot_idx++) {
+        m_frames[slot_idx].cmd_idx = slot_idx;
+        initFrameSlot(m_frames[slot_idx], 1);
+    }
 
-    // Create buffer to receive rendered images
-    size_t n_img_bytes = m_swapchain->size.width * m_swapchain->size.height *
-                         sizeof(float) * 4;
-    m_color_recv_buf = vkw::CreateBufferPack(
-            m_physical_device, m_device, n_img_bytes,
-            vk::BufferUsageFlagBits::eTransferDst, vkw::HOST_VISIB_COHER_PROPS);
-    m_pos_recv_buf = vkw::CreateBufferPack(
-            m_physical_device, m_device, n_img_bytes,
-            vk::BufferUsageFlagBits::eTransferDst, vkw::HOST_VISIB_COHER_PROPS);
+    // Get pipeline (descriptor set layouts and render passes are same over
+    // frame slots and renderers of the context)
+    SurfaceOutput surface_output = SurfaceOutput::NONE;
+    if (m_id_output) {
+        surface_output = SurfaceOutput::POS_ID;
+    } else if (m_dense_readback) {
+        surface_output = SurfaceOutput::POS;
+    }
+    m_pipeline = m_context->getPipeline(
+            GetVkFormat(m_color_format),
+            surface_output,
+            [&](const vkw::ShaderModulePackPtr& vert_shader,
+                const vkw::ShaderModulePackPtr& frag_shader,
+                const vk::UniquePipelineCache& pipeline_cache) {
+                vkw::PipelineInfo pipeline_info;
+                pipeline_info.color_blend_infos.resize(color_refs.size());
+                pipeline_info.face_culling = vk::CullModeFlagBits::eNone;
+                return vkw::CreateGraphicsPipeline(
+                        device, {vert_shader, frag_shader},
+                        {{0, sizeof(Vertex), vk::VertexInputRate::eVertex}},
+                        {{0, 0, vk::Format::eR32G32B32Sfloat,
+                          offsetof(Vertex, pos)},
+                         {1, 0, vk::Format::eR32G32Sfloat,
+                          offsetof(Vertex, uv)}},
+                        pipeline_info, {m_frames[0].desc_set}, m_render_pass,
+                        0, pipeline_cache);
+            });
+
+    // Create command buffers (one for each frame slot and batches)
+    m_cmd_bufs = vkw::CreateCommandBuffersPack(device, queue_family_idx,
+                                               m_n_frames + 1);
 
     // Send color texture to GPU
-    uint64_t tex_n_bytes = m_mesh.color_tex.pixels.size() * sizeof(float);
+    uint64_t tex_n_bytes = uint64_t(m_mesh->color_tex.width) *
+                           m_mesh->color_tex.height * m_mesh->color_tex.n_ch;
     auto trans_buf_pack = vkw::CreateBufferPack(  // Create temporal buffer
-            m_physical_device, m_device, tex_n_bytes,
+            physical_device, device, tex_n_bytes,
             vk::BufferUsageFlagBits::eTransferSrc, vkw::HOST_VISIB_COHER_PROPS);
-    vkw::SendToDevice(m_device, trans_buf_pack,  // Send from CPU to buf
-                      m_mesh.color_tex.pixels.data(), tex_n_bytes);
+    vkw::SendToDevice(device, trans_buf_pack,  // Send from CPU to buf
+                      m_mesh->color_tex.pixels, tex_n_bytes);  // (or mapped)
     auto& send_cmd_buf = m_cmd_bufs->cmd_bufs[0];  // Use 1st command buffer
     vkw::BeginCommand(send_cmd_buf);
     vkw::CopyBufferToImage(send_cmd_buf,  // Stack sending cmd from buf to img
                            trans_buf_pack, m_color_tex->img_pack);
     vkw::EndCommand(send_cmd_buf);
-    auto send_fence = vkw::CreateFence(m_device);
-    vkw::QueueSubmit(m_queue, send_cmd_buf, send_fence, {}, {});  // Execute
-    vkw::WaitForFences(m_device, {send_fence});
+    auto send_fence = vkw::CreateFence(device);
+    m_context->submit(send_cmd_buf, send_fence);  // Execute
+    vkw::WaitForFences(device, {send_fence});
+}
+
+void Renderer::initFrameSlot(FrameSlot& slot, uint32_t n_tiles) {
+    const vk::PhysicalDevice& physical_device = m_context->getPhysicalDevice();
+    const vk::UniqueDevice& device = m_context->getDevice();
+    const vk::Extent2D img_size = {m_width, m_height * n_tiles};
+    slot.n_tiles = n_tiles;
+
+    // Create attachment images
+    slot.color_img = vkw::CreateImagePack(
+            physical_device, device, GetVkFormat(m_color_format), img_size, 1,
+            vk::ImageUsageFlagBits::eColorAttachment |
+                    vk::ImageUsageFlagBits::eTransferSrc,
+            {}, true);
+    if (m_dense_readback) {
+        slot.pos_img = vkw::CreateImagePack(
+                physical_device, device, POS_FORMAT, img_size, 1,
+                vk::ImageUsageFlagBits::eColorAttachment |
+                        vk::ImageUsageFlagBits::eTransferSrc,
+                {}, true);
+    }
+    if (m_id_output) {
+        slot.id_img = vkw::CreateImagePack(
+                physical_device, device, ID_FORMAT, img_size, 1,
+                vk::ImageUsageFlagBits::eColorAttachment |
+                        vk::ImageUsageFlagBits::eTransferSrc,
+                {}, true);
+    }
+    slot.depth_img = vkw::CreateImagePack(
+            physical_device, device, DEPTH_FORMAT, img_size, 1,
+            vk::ImageUsageFlagBits::eDepthStencilAttachment, {}, true,
+            vk::ImageAspectFlagBits::eDepth);
+
+    // Attachments in the order of the render pass
+    std::vector<vkw::ImagePackPtr> att_imgs = {slot.color_img};
+    if (m_dense_readback) {
+        att_imgs.push_back(slot.pos_img);
+    }
+    if (m_id_output) {
+        att_imgs.push_back(slot.id_img);
+    }
+    att_imgs.push_back(slot.depth_img);
+    if (m_window) {
+        // Create frame buffers for swapchain images
+        att_imgs.insert(att_imgs.begin(), nullptr);
+        slot.framebuffers = vkw::CreateFrameBuffers(device, m_render_pass,
+                                                    att_imgs, m_swapchain);
+    } else {
+        // Create a frame buffer for offscreen images
+        slot.framebuffers = {
+                vkw::CreateFrameBuffer(device, m_render_pass, att_imgs)};
+    }
+
+    // Create uniform buffer (a matrix for each tile)
+    slot.uniform_buf = vkw::CreateBufferPack(
+            physical_device, device, m_uniform_stride * n_tiles,
+            vk::BufferUsageFlagBits::eUniformBuffer,
+            vkw::HOST_VISIB_COHER_PROPS);
+
+    // Create descriptor set for uniform buffer, texture and mesh buffers
+    slot.desc_set = vkw::CreateDescriptorSetPack(
+            device, {{vk::DescriptorType::eUniformBufferDynamic, 1,
+                      vk::ShaderStageFlagBits::eVertex},
+                     {vk::DescriptorType::eCombinedImageSampler, 1,
+                      vk::ShaderStageFlagBits::eFragment},
+                     {vk::DescriptorType::eStorageBuffer, 1,
+                      vk::ShaderStageFlagBits::eFragment},
+                     {vk::DescriptorType::eStorageBuffer, 1,
+                      vk::ShaderStageFlagBits::eFragment}});
+    // Bind descriptor set with actual buffer
+    slot.write_desc_set = vkw::CreateWriteDescSetPack();
+    vkw::AddWriteDescSet(slot.write_desc_set, slot.desc_set, 1,
+                         {m_color_tex},  // layout is still undefined.
+                         {vk::ImageLayout::eShaderReadOnlyOptimal});
+    vkw::AddWriteDescSet(slot.write_desc_set, slot.desc_set, 2, {m_idx_buf});
+    vkw::AddWriteDescSet(slot.write_desc_set, slot.desc_set, 3, {m_vtx_buf});
+    vkw::UpdateDescriptorSets(device, slot.write_desc_set);
+    // Uniform buffer with the range of one matrix (vkw binds whole buffers,
+    // which dynamic offsets of tiles would overrun)
+    const vk::DescriptorBufferInfo uniform_info(slot.uniform_buf->buf.get(),
+                                                0, sizeof(glm::mat4));
+    device->updateDescriptorSets(
+            {vk::WriteDescriptorSet(slot.desc_set->desc_set.get(), 0, 0, 1,
+                                    vk::DescriptorType::eUniformBufferDynamic,
+                                    nullptr, &uniform_info)},
+            {});
+
+    // Create buffer to receive rendered images
+    const size_t n_pixs = size_t(m_width) * m_height * n_tiles;
+    const size_t n_col_bytes = n_pixs * getColorBytes();
+    const size_t n_pos_bytes = n_pixs * sizeof(float) * 4;
+    const size_t n_id_bytes = n_pixs * sizeof(uint32_t);
+    slot.color_recv_buf = vkw::CreateBufferPack(
+            physical_device, device, n_col_bytes,
+            vk::BufferUsageFlagBits::eTransferDst, vkw::HOST_VISIB_COHER_PROPS);
+    // Map them persistently (coherent, unmapped when freed)
+    slot.color_ptr = device->mapMemory(slot.color_recv_buf->dev_mem.get(), 0,
+                                       n_col_bytes);
+    if (!m_dense_readback) {
+        return;  // Surface points are queried by ray casting
+    }
+    slot.pos_recv_buf = vkw::CreateBufferPack(
+            physical_device, device, n_pos_bytes,
+            vk::BufferUsageFlagBits::eTransferDst, vkw::HOST_VISIB_COHER_PROPS);
+    slot.pos_ptr = static_cast<const float*>(device->mapMemory(
+            slot.pos_recv_buf->dev_mem.get(), 0, n_pos_bytes));
+    if (!m_id_output) {
+        return;  // Vertex indices are searched from positions
+    }
+    slot.id_recv_buf = vkw::CreateBufferPack(
+            physical_device, device, n_id_bytes,
+            vk::BufferUsageFlagBits::eTransferDst, vkw::HOST_VISIB_COHER_PROPS);
+    slot.id_ptr = static_cast<const uint32_t*>(device->mapMemory(
+            slot.id_recv_buf->dev_mem.get(), 0, n_id_bytes));
+}
+
+void Renderer::recordDraw(uint32_t cmd_idx, const FrameSlot* slots,
+                          uint32_t n_views, uint32_t framebuffer_idx) {
+    auto& cmd_buf = m_cmd_bufs->cmd_bufs[cmd_idx];
+    const bool gpu_timed = slots[0].gpu_timed;
 
     // Stack draw command
-    for (uint32_t cmd_idx = 0; cmd_idx < n_cmd_bufs; cmd_idx++) {
-        auto& cmd_buf = m_cmd_bufs->cmd_bufs[cmd_idx];
-
-        vkw::ResetCommand(cmd_buf);
-        vkw::BeginCommand(cmd_buf);
-        const std::array<float, 4> clear_color = {0.f, 0.f, 0.f, 1.f};
-        vkw::CmdBeginRenderPass(cmd_buf, m_render_pass, m_framebuffers[cmd_idx],
-                                {vk::ClearColorValue(clear_color),
-                                 vk::ClearColorValue(clear_color),
-                                 vk::ClearColorValue(clear_color),
-                                 vk::ClearDepthStencilValue(1.f, 0)});
+    vkw::ResetCommand(cmd_buf);
+    vkw::BeginCommand(cmd_buf);
+    const uint32_t query_idx = cmd_idx * 2;
+    if (gpu_timed) {
+        cmd_buf->resetQueryPool(m_query_pool.get(), query_idx, 2);
+        cmd_buf->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                                m_query_pool.get(), query_idx);
+    }
+    const std::array<float, 4> clear_color = {0.f, 0.f, 0.f, 1.f};
+    const uint32_t n_float_atts =  // Window, color and position
+            (m_window ? 1u : 0u) + 1u + (m_dense_readback ? 1u : 0u);
+    std::vector<vk::ClearValue> clear_vals(n_float_atts,
+                                           vk::ClearColorValue(clear_color));
+    if (m_id_output) {
+        const std::array<uint32_t, 4> clear_id = {INVALID_VTX_IDX, 0, 0, 0};
+        clear_vals.emplace_back(vk::ClearColorValue(clear_id));
+    }
+    clear_vals.emplace_back(vk::ClearDepthStencilValue(1.f, 0));
+    for (uint32_t view_idx = 0; view_idx < n_views; slots++) {
+        const FrameSlot& slot = *slots;
+        const uint32_t n_slot_views =
+                std::min(slot.n_tiles, n_views - view_idx);
+        vkw::CmdBeginRenderPass(cmd_buf, m_render_pass,
+                                slot.framebuffers[framebuffer_idx], clear_vals);
         vkw::CmdBindPipeline(cmd_buf, m_pipeline);
-        const std::vector<uint32_t> dynamic_offsets = {0};
-        vkw::CmdBindDescSets(cmd_buf, m_pipeline, {m_desc_set},
-                             dynamic_offsets);
         vkw::CmdBindVertexBuffers(cmd_buf, 0, {m_vtx_buf});
-        vkw::CmdSetViewport(cmd_buf, m_swapchain->size);
-        vkw::CmdSetScissor(cmd_buf, m_swapchain->size);
-        vkw::CmdDraw(cmd_buf, m_mesh.vertices.size());
+        vkw::CmdBindIndexBuffer(cmd_buf, m_idx_buf, 0, vk::IndexType::eUint32);
+        // Tiles by viewports (with the matrix at the dynamic offset)
+        for (uint32_t tile_idx = 0; tile_idx < n_slot_views; tile_idx++) {
+            const uint32_t tile_y = m_height * tile_idx;
+            const std::vector<uint32_t> dynamic_offsets = {m_uniform_stride *
+                                                           tile_idx};
+            vkw::CmdBindDescSets(cmd_buf, m_pipeline, {slot.desc_set},
+                                 dynamic_offsets);
+            cmd_buf->setViewport(
+                    0, vk::Viewport(0.f, float(tile_y), float(m_width),
+                                    float(m_height), 0.f, 1.f));
+            cmd_buf->setScissor(
+                    0, vk::Rect2D({0, int32_t(tile_y)}, {m_width, m_height}));
+            vkw::CmdDrawIndexed(cmd_buf,
+                                static_cast<uint32_t>(m_mesh->indices.size()));
+        }
+        view_idx += n_slot_views;
         vkw::CmdEndRenderPass(cmd_buf);
-        vkw::CopyImageToBuffer(cmd_buf, m_color_img, m_color_recv_buf);
-        vkw::CopyImageToBuffer(cmd_buf, m_pos_img, m_pos_recv_buf);
-        vkw::EndCommand(cmd_buf);
+        vkw::CopyImageToBuffer(cmd_buf, slot.color_img, slot.color_recv_buf);
+        if (m_dense_readback) {
+            vkw::CopyImageToBuffer(cmd_buf, slot.pos_img, slot.pos_recv_buf);
+        }
+        if (m_dense_readback && m_id_output) {
+            vkw::CopyImageToBuffer(cmd_buf, slot.id_img, slot.id_recv_buf);
+        }
+    }
+    if (gpu_timed) {
+        cmd_buf->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                                m_query_pool.get(), query_idx + 1);
+    }
+    vkw::EndCommand(cmd_buf);
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Surface Points -------------------------------
+// -----------------------------------------------------------------------------
+std::vector<SurfacePoint> QuerySurfacePoints(
+        const FrameView& frame, const Mesh& mesh,
+        const std::vector<glm::ivec2>& pixels) {
+    ProfileZone zone("QuerySurfacePoints");
+    const uint32_t width = frame.color.empty() ? frame.color_f.width :
+                                                 frame.color.width;
+    const uint32_t height = frame.color.empty() ? frame.color_f.height :
+                                                  frame.color.height;
+    const glm::mat4 inv_mvpc_mat = glm::inverse(frame.mvpc_mat);
+
+    std::vector<SurfacePoint> ret(pixels.size());
+    std::vector<glm::vec3> queries;
+    std::vector<uint32_t> query_idxs;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        const glm::ivec2& pix = pixels[i];
+        if (pix.x < 0 || pix.y < 0 || int(width) <= pix.x ||
+            int(height) <= pix.y) {
+            continue;  // Out of image
+        }
+        const uint32_t pix_idx = uint32_t(pix.y) * width + uint32_t(pix.x);
+
+        if (frame.pos.empty()) {
+            // Cast ray through the pixel center
+            const glm::vec2 ndc =
+                    (glm::vec2(pix) + 0.5f) / glm::vec2(width, height) * 2.f -
+                    1.f;
+            ret[i] = CastRay(mesh, inv_mvpc_mat, ndc);
+            continue;
+        }
+
+        // Read received images
+        const float* pos = &frame.pos.pixels[pix_idx * frame.pos.n_ch];
+        ret[i].pos = {pos[0], pos[1], pos[2]};
+        if (!frame.id.empty()) {
+            ret[i].vtx_idx = frame.id.pixels[pix_idx];
+        } else if (pos[0] != 0.f && pos[1] != 0.f && pos[2] != 0.f) {
+            // Register query of nearest vertex (escape background)
+            queries.push_back(ret[i].pos);
+            query_idxs.push_back(static_cast<uint32_t>(i));
+        }
     }
+
+    // Search nearest vertices at once (only without vertex index image)
+    ProfileZone search_zone("KdTree::findNearest");
+    const std::vector<uint32_t>& vtx_idxs = mesh.vtx_tree.findNearest(queries);
+    for (size_t i = 0; i < vtx_idxs.size(); i++) {
+        ret[query_idxs[i]].vtx_idx = vtx_idxs[i];
+    }
+#ifndef NDEBUG
+    ValidateNearestVertices(mesh, queries, vtx_idxs);
+#endif
+
+    return ret;
+}
+
+bool ProjectMeshBox(const glm::mat4& mvpc_mat, const Mesh& mesh,
+                    uint32_t width, uint32_t height, glm::vec2& min_pix,
+                    glm::vec2& max_pix) {
+    // Project corners of the mesh bounds
+    min_pix = glm::vec2(std::numeric_limits<float>::max());
+    max_pix = glm::vec2(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < 8; i++) {
+        const glm::vec3 corner = {(i & 1) ? mesh.max_pos.x : mesh.min_pos.x,
+                                  (i & 2) ? mesh.max_pos.y : mesh.min_pos.y,
+                                  (i & 4) ? mesh.max_pos.z : mesh.min_pos.z};
+        const glm::vec4 clip = mvpc_mat * glm::vec4(corner, 1.f);
+        if (clip.w <= 0.f) {
+            return false;  // Crossing camera plane
+        }
+        // Inverse of pixel center mapping in `QuerySurfacePoints`
+        const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        const glm::vec2 pix =
+                (ndc + 1.f) * 0.5f * glm::vec2(width, height) - 0.5f;
+        min_pix = glm::min(min_pix, pix);
+        max_pix = glm::max(max_pix, pix);
+    }
+
+    // Clip to image
+    min_pix = glm::max(min_pix, glm::vec2(0.f));
+    max_pix = glm::min(max_pix, glm::vec2(width - 1, height - 1));
+    return min_pix.x < max_pix.x && min_pix.y < max_pix.y;
 }
 
 // -----------------------------------------------------------------------------
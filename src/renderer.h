@@ -2,7 +2,14 @@
 #define RENDERER_H_20210212
 #include <vkw/vkw.h>
 
+#include <map>
+#include <memory>
+
+#include "bvh.h"
 #include "image.h"
+#include "kdtree.h"
+#include "rasterizer.h"
+#include "render_context.h"
 
 BEGIN_VKW_SUPPRESS_WARNING
 #include <glm/geometric.hpp>
@@ -20,52 +27,213 @@ struct Vertex {
     uint32_t vtx_idx;  // Vertex Index
 };
 
+// `vtx_idx` of background pixels
+constexpr uint32_t INVALID_VTX_IDX = uint32_t(~0);
+
+// Unique in the process (from 1), so meshes allocated at the address of a
+// freed one are told apart
+uint64_t GenMeshId();
+
 struct Mesh {
-    std::vector<Vertex> vertices;  // Flatten vertices over all meshes
-    FloatImage color_tex;          // Color texture (Unlit Shading)
+    uint64_t id = GenMeshId();     // Kept by copies of the same contents
+    std::vector<Vertex> vertices;  // Unique (position, uv) over all meshes
+    std::vector<uint32_t> indices;  // Triangle list into `vertices`
+    glm::vec3 min_pos{0.f};        // Bounding box of `vertices`
+    glm::vec3 max_pos{0.f};
+    ByteImageView color_tex;       // Color texture (Unlit Shading)
+    std::shared_ptr<const void> color_tex_owner;  // Decoded or mapped pixels
+    KdTree vtx_tree;               // Unique vertex positions (ID: vtx_idx)
+    Bvh tri_bvh;                   // Triangles of `vertices` and `indices`
+};
+
+// Position and vertex index on the mesh surface seen at a pixel
+struct SurfacePoint {
+    glm::vec3 pos{0.f};                 // Zero for background
+    uint32_t vtx_idx = INVALID_VTX_IDX;  // Nearest corner of the triangle
 };
 
 // -----------------------------------------------------------------------------
-// ----------------------- 3D Renderer by Vulkan Backend -----------------------
+// --------------------------------- 3D Renderer -------------------------------
 // -----------------------------------------------------------------------------
+enum class RenderBackend {
+    VULKAN,  // GPU rendering (offscreen when no window is given)
+    CPU,     // Software rasterizer (no GPU nor display is needed)
+};
+
+enum class ColorFormat {
+    RGBA32F,  // 16 bytes per pixel
+    RGBA8,    // 4 bytes per pixel (same as texture precision)
+};
+
+using DrawTicket = uint64_t;
+
+// Rendered images mapped from device memory. They are valid until the frame
+// slot is reused (`n_frames` submits later) or the mesh is reloaded.
+struct FrameView {
+    ByteImageView color;     // Color for `ColorFormat::RGBA8`
+    FloatImageView color_f;  // Color for `ColorFormat::RGBA32F`
+    FloatImageView pos;      // Position
+    ImageView<uint32_t> id;  // Vertex index (`INVALID_VTX_IDX` for background)
+    glm::mat4 mvpc_mat{1.f};  // Drawn matrix (with Vulkan clip correction)
+};
+
+// Clip correction for Vulkan (Y-flip and [0, 1] depth). `mvpc_mat` of a view
+// is `CLIP_MAT * mvp_mat`.
+extern const glm::mat4 CLIP_MAT;
+
+// Looks up surface points at the given pixels. Reads `pos` and `id` images
+// when they are received, otherwise casts rays against `mesh.tri_bvh`.
+std::vector<SurfacePoint> QuerySurfacePoints(
+        const FrameView& frame, const Mesh& mesh,
+        const std::vector<glm::ivec2>& pixels);
+
+// Screen-space bounding box of the mesh bounds in pixels (clipped to image).
+// Returns false when the bounds cross the camera plane or miss the image.
+bool ProjectMeshBox(const glm::mat4& mvpc_mat, const Mesh& mesh,
+                    uint32_t width, uint32_t height, glm::vec2& min_pix,
+                    glm::vec2& max_pix);
+
+// Loads OBJ and its texture through binary cache next to the file (written
+// on miss). Thread-safe, so meshes can be loaded ahead of rendering.
+Mesh LoadMesh(const std::string& filename, bool use_cache = true);
+
 class Renderer {
 public:
-    Renderer(const vkw::WindowPtr& window);
-    void loadObj(const std::string& filename);
+    Renderer(const vkw::WindowPtr& window,
+             RenderBackend backend = RenderBackend::VULKAN);
+    Renderer(uint32_t width, uint32_t height,
+             RenderBackend backend = RenderBackend::CPU);
+    // Vulkan session sharing the device and pipelines of the context. Use a
+    // renderer for each thread (a context with window is for one renderer).
+    Renderer(std::shared_ptr<RenderContext> context, uint32_t width,
+             uint32_t height);
+    ~Renderer();  // Waits for pending draws
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+    // Same as `setMesh(LoadMesh(...))`
+    void loadObj(const std::string& filename, bool use_cache = true);
+    // Mesh is shared with the caller (e.g. for surface queries of frames)
+    void setMesh(std::shared_ptr<const Mesh> mesh);
     const Mesh& getMesh() const;
+    std::shared_ptr<const Mesh> getMeshPtr() const;
+    RenderBackend getBackend() const;
+    // Context created at the first draw unless given (null for CPU)
+    std::shared_ptr<RenderContext> getContext() const;
+    void setFramesInFlight(uint32_t n_frames);
+    void setColorFormat(ColorFormat color_format);
+    // Receives position and vertex index images (default). When disabled,
+    // only color is transferred, and `FrameView::pos` and `id` are empty.
+    // `id` is also empty on devices without the geometry shader feature.
+    void setDenseReadback(bool enabled);
+    // Pipeline cache file kept between runs (empty to disable). Used when
+    // the renderer creates its own context.
+    void setPipelineCachePath(const std::string& filename);
+
+    // Synchronous drawing
     std::tuple<FloatImage, FloatImage> draw(const glm::mat4& mvp_mat);
 
+    // Asynchronous drawing. Up to `n_frames` draws run on GPU while the
+    // caller works on former results. When a frame slot is reused, its
+    // pending draw is completed and kept until `waitDraw` is called (the
+    // latest 32 of them, older ones are dropped).
+    DrawTicket submitDraw(const glm::mat4& mvp_mat);
+    std::vector<DrawTicket> submitDraws(const std::vector<glm::mat4>& mvp_mats);
+    std::tuple<FloatImage, FloatImage> waitDraw(DrawTicket ticket);
+    // Zero-copy version of `waitDraw`
+    FrameView waitDrawView(DrawTicket ticket);
+
+    // Batched drawing. All views are drawn into tiles of one target (stacked
+    // vertically) by a single submission, and received by one readback.
+    // Views over the device limit of a target continue on further targets in
+    // the same command buffer. Returned views are valid until the next batch
+    // or the mesh is reloaded. With a window or the CPU backend, views are
+    // drawn one by one.
+    std::vector<FrameView> drawBatchViews(
+            const std::vector<glm::mat4>& mvp_mats);
+
 private:
-    void init();
+    struct StoredDraw {
+        std::vector<uint8_t> color;
+        std::vector<float> pos;
+        std::vector<uint32_t> id;
+        glm::mat4 mvpc_mat;
+    };
+
+    struct FrameSlot {
+        vkw::ImagePackPtr color_img;
+        vkw::ImagePackPtr pos_img;
+        vkw::ImagePackPtr id_img;
+        vkw::ImagePackPtr depth_img;
+        std::vector<vkw::FrameBufferPackPtr> framebuffers;
+        vkw::BufferPackPtr uniform_buf;
+        vkw::DescSetPackPtr desc_set;
+        vkw::WriteDescSetPackPtr write_desc_set;
+        vkw::BufferPackPtr color_recv_buf;
+        vkw::BufferPackPtr pos_recv_buf;
+        vkw::BufferPackPtr id_recv_buf;
+        vkw::FencePtr fence;
+        vkw::SemaphorePtr img_acquired_semaphore;
+        uint32_t n_tiles = 1;  // Views stacked vertically in the images
+        uint32_t cmd_idx = 0;  // Command buffer and timestamp queries
+        DrawTicket ticket = 0;
+        bool pending = false;
+        bool gpu_timed = false;  // Timestamps are written while profiling
+        int64_t submit_ns = 0;   // Profiler time at submission
+        glm::mat4 mvpc_mat;
+        const void* color_ptr = nullptr;  // Persistently mapped (or CPU)
+        const float* pos_ptr = nullptr;
+        const uint32_t* id_ptr = nullptr;
+        std::vector<uint8_t> cpu_color;  // CPU backend results
+        std::vector<float> cpu_pos;
+        std::vector<uint32_t> cpu_id;
+    };
+
+    void init();  // For each mesh and settings
+    void initFrameSlot(FrameSlot& slot, uint32_t n_tiles);
+    // Records `n_views` tiles filling `slots` in order (with their readback)
+    void recordDraw(uint32_t cmd_idx, const FrameSlot* slots, uint32_t n_views,
+                    uint32_t framebuffer_idx);
+    void complete(FrameSlot& slot);
+    FrameView makeFrameView(const void* color_ptr, const float* pos_ptr,
+                            const uint32_t* id_ptr,
+                            const glm::mat4& mvpc_mat) const;
+    FrameView makeTileView(const FrameSlot& slot, uint32_t tile_idx,
+                           const glm::mat4& mvpc_mat) const;
+    size_t getColorBytes() const;
 
-    Mesh m_mesh;
+    std::shared_ptr<const Mesh> m_mesh = std::make_shared<const Mesh>();
     bool m_inited = false;
 
+    RenderBackend m_backend;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    SoftRasterizer m_soft_rasterizer;
+
     vkw::WindowPtr m_window;
-    vk::UniqueInstance m_instance;
-    vk::PhysicalDevice m_physical_device;
-    vk::UniqueSurfaceKHR m_surface;
-    vk::Format m_surface_format;
-    uint32_t m_queue_family_idx;
-    vk::UniqueDevice m_device;
+    std::string m_pipeline_cache_path = GetDefaultPipelineCachePath();
+    std::shared_ptr<RenderContext> m_context;  // Outlives resources below
     vkw::SwapchainPackPtr m_swapchain;
-    vk::Queue m_queue;
-    vkw::ImagePackPtr m_color_img;
-    vkw::ImagePackPtr m_pos_img;
-    vkw::ImagePackPtr m_depth_img;
-    vkw::BufferPackPtr m_uniform_buf;
     vkw::TexturePackPtr m_color_tex;
-    vkw::DescSetPackPtr m_desc_set;
-    vkw::WriteDescSetPackPtr m_write_desc_set;
     vkw::RenderPassPackPtr m_render_pass;
-    std::vector<vkw::FrameBufferPackPtr> m_framebuffers;
-    vkw::ShaderModulePackPtr m_vert_shader;
-    vkw::ShaderModulePackPtr m_frag_shader;
     vkw::BufferPackPtr m_vtx_buf;
-    vkw::PipelinePackPtr m_pipeline;
+    vkw::BufferPackPtr m_idx_buf;
+    vkw::PipelinePackPtr m_pipeline;  // Shared in the context
     vkw::CommandBuffersPackPtr m_cmd_bufs;
-    vkw::BufferPackPtr m_color_recv_buf;
-    vkw::BufferPackPtr m_pos_recv_buf;
+    vk::UniqueQueryPool m_query_pool;  // Null without timestamp support
+    double m_timestamp_period = 0.0;   // Nanoseconds per timestamp tick
+    uint64_t m_timestamp_mask = 0;     // Valid bits of timestamps
+    uint32_t m_uniform_stride = sizeof(glm::mat4);  // Dynamic offset unit
+    uint32_t m_max_tiles = 1;  // Views in a batch target (device limit)
+
+    uint32_t m_n_frames = 2;
+    ColorFormat m_color_format = ColorFormat::RGBA32F;
+    bool m_dense_readback = true;
+    bool m_id_output = true;  // Vertex index image is drawn (device support)
+    std::vector<FrameSlot> m_frames;
+    std::vector<FrameSlot> m_batch_targets;  // Tiles of batched views
+    DrawTicket m_next_ticket = 0;
+    std::map<DrawTicket, StoredDraw> m_done_draws;
+    StoredDraw m_viewed_draw;  // Backing of the last view of a stored draw
 };
 
 // -----------------------------------------------------------------------------
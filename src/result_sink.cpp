@@ -0,0 +1,300 @@
+#include "result_sink.h"
+
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include "bounded_queue.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Constant Values ------------------------------
+// -----------------------------------------------------------------------------
+const size_t BUFFER_SIZE = 1 << 20;     // Bytes buffered before writing
+const size_t ASYNC_QUEUE_SIZE = 256;    // Records waiting for writer thread
+const char BINARY_MAGIC[8] = {'F', 'L', 'M', 'K', 'R', 'E', 'S', '1'};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+const char* GetStatusName(ResultStatus status) {
+    switch (status) {
+        case ResultStatus::OK: return "ok";
+        case ResultStatus::NO_FACE: return "no_face";
+        case ResultStatus::FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+void AppendJsonString(std::string& buf, const std::string& str) {
+    buf += '"';
+    for (const char c : str) {
+        switch (c) {
+            case '"': buf += "\\\""; break;
+            case '\\': buf += "\\\\"; break;
+            case '\n': buf += "\\n"; break;
+            case '\r': buf += "\\r"; break;
+            case '\t': buf += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char tmp[8];
+                    std::snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+                    buf += tmp;
+                } else {
+                    buf += c;
+                }
+        }
+    }
+    buf += '"';
+}
+
+void AppendNumber(std::string& buf, float v) {
+    if (!std::isfinite(v)) {
+        buf += "null";  // JSON has no NaN nor infinity
+        return;
+    }
+    char tmp[32];
+    const int n = std::snprintf(tmp, sizeof(tmp), "%.7g", double(v));
+    buf.append(tmp, static_cast<size_t>(n));
+}
+
+template <typename T>
+void AppendPod(std::string& buf, const T& v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// -----------------------------------------------------------------------------
+// --------------------------------- File Sinks --------------------------------
+// -----------------------------------------------------------------------------
+// Encodes records into a buffer written out in large blocks
+class FileSink : public ResultSink {
+public:
+    FileSink(const std::string& filename) {
+        if (filename == "-") {
+            m_fp = stdout;
+        } else {
+            m_fp = std::fopen(filename.c_str(), "wb");
+            if (!m_fp) {
+                throw std::runtime_error("Failed to open " + filename);
+            }
+            m_owned = true;
+        }
+    }
+
+    ~FileSink() override {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    void close() override {
+        if (!m_fp) {
+            return;
+        }
+        writeBuffer();
+        bool ok = !m_failed && std::fflush(m_fp) == 0;
+        if (m_owned) {
+            ok = (std::fclose(m_fp) == 0) && ok;
+        }
+        m_fp = nullptr;
+        if (!ok) {
+            throw std::runtime_error("Failed to write results");
+        }
+    }
+
+protected:
+    // Called after each record
+    void commit() {
+        if (BUFFER_SIZE <= m_buf.size()) {
+            writeBuffer();
+        }
+    }
+
+    std::string m_buf;
+
+private:
+    void writeBuffer() {
+        if (!m_buf.empty() &&
+            std::fwrite(m_buf.data(), 1, m_buf.size(), m_fp) != m_buf.size()) {
+            m_failed = true;
+        }
+        m_buf.clear();
+    }
+
+    std::FILE* m_fp = nullptr;
+    bool m_owned = false;
+    bool m_failed = false;
+};
+
+class JsonLinesSink : public FileSink {
+public:
+    using FileSink::FileSink;
+
+    void write(const ResultRecord& record) override {
+        AppendJsonLine(m_buf, record);
+        commit();
+    }
+};
+
+class BinarySink : public FileSink {
+public:
+    BinarySink(const std::string& filename) : FileSink(filename) {
+        m_buf.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    }
+
+    void write(const ResultRecord& record) override {
+        const uint8_t status_pad[4] = {static_cast<uint8_t>(record.status), 0,
+                                       0, 0};
+        AppendPod(m_buf, record.mesh_idx);
+        AppendPod(m_buf, status_pad);
+        AppendPod(m_buf, record.load_ms);
+        AppendPod(m_buf, record.render_ms);
+        AppendPod(m_buf, record.detect_ms);
+        AppendPod(m_buf, static_cast<uint32_t>(record.filename.size()));
+        AppendPod(m_buf, static_cast<uint32_t>(record.error.size()));
+        AppendPod(m_buf, static_cast<uint32_t>(record.landmarks.size()));
+        m_buf += record.filename;
+        m_buf += record.error;
+        for (auto&& lmk : record.landmarks) {
+            AppendPod(m_buf, static_cast<int32_t>(lmk.lmk_2d.x));
+            AppendPod(m_buf, static_cast<int32_t>(lmk.lmk_2d.y));
+            AppendPod(m_buf, lmk.lmk_3d.x);
+            AppendPod(m_buf, lmk.lmk_3d.y);
+            AppendPod(m_buf, lmk.lmk_3d.z);
+            AppendPod(m_buf, lmk.vtx_idx);
+        }
+        commit();
+    }
+};
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Async Sink --------------------------------
+// -----------------------------------------------------------------------------
+// Hands records to a writer thread (callers wait only when it falls behind)
+class AsyncSink : public ResultSink {
+public:
+    AsyncSink(std::unique_ptr<ResultSink> sink)
+        : m_sink(std::move(sink)), m_queue(ASYNC_QUEUE_SIZE) {
+        m_thread = std::thread([this]() {
+            ResultRecord record;
+            while (m_queue.pop(record)) {
+                if (m_error) {
+                    continue;  // Drain after failure
+                }
+                try {
+                    m_sink->write(record);
+                } catch (...) {
+                    m_error = std::current_exception();
+                }
+            }
+        });
+    }
+
+    ~AsyncSink() override {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    void write(const ResultRecord& record) override {
+        if (!m_queue.push(record)) {
+            throw std::runtime_error("Result sink is already closed");
+        }
+    }
+
+    void close() override {
+        if (!m_thread.joinable()) {
+            return;
+        }
+        m_queue.close();
+        m_thread.join();
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+        m_sink->close();
+    }
+
+private:
+    std::unique_ptr<ResultSink> m_sink;
+    BoundedQueue<ResultRecord> m_queue;
+    std::thread m_thread;
+    std::exception_ptr m_error;  // Read after join
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Result Sink -------------------------------
+// -----------------------------------------------------------------------------
+void AppendJsonLine(std::string& buf, const ResultRecord& record) {
+    buf += "{\"mesh_idx\":";
+    buf += std::to_string(record.mesh_idx);
+    buf += ",\"filename\":";
+    AppendJsonString(buf, record.filename);
+    buf += ",\"status\":\"";
+    buf += GetStatusName(record.status);
+    buf += "\"";
+    if (!record.error.empty()) {
+        buf += ",\"error\":";
+        AppendJsonString(buf, record.error);
+    }
+    buf += ",\"time_ms\":{\"load\":";
+    AppendNumber(buf, record.load_ms);
+    buf += ",\"render\":";
+    AppendNumber(buf, record.render_ms);
+    buf += ",\"detect\":";
+    AppendNumber(buf, record.detect_ms);
+    // Landmark as `[x, y, X, Y, Z, vtx_idx]`
+    buf += "},\"landmarks\":[";
+    for (size_t i = 0; i < record.landmarks.size(); i++) {
+        const Landmark& lmk = record.landmarks[i];
+        buf += (i == 0) ? "[" : ",[";
+        buf += std::to_string(lmk.lmk_2d.x);
+        buf += ',';
+        buf += std::to_string(lmk.lmk_2d.y);
+        for (int k = 0; k < 3; k++) {
+            buf += ',';
+            AppendNumber(buf, lmk.lmk_3d[k]);
+        }
+        buf += ',';
+        buf += std::to_string(lmk.vtx_idx);
+        buf += ']';
+    }
+    buf += "]}\n";
+}
+
+std::unique_ptr<ResultSink> CreateResultSink(const std::string& filename,
+                                             ResultFormat format, bool async) {
+    std::unique_ptr<ResultSink> sink;
+    if (format == ResultFormat::BINARY) {
+        sink = std::make_unique<BinarySink>(filename);
+    } else {
+        sink = std::make_unique<JsonLinesSink>(filename);
+    }
+    if (async) {
+        sink = std::make_unique<AsyncSink>(std::move(sink));
+    }
+    return sink;
+}
+
+ResultFormat ParseResultFormat(const std::string& name) {
+    if (name == "jsonl") {
+        return ResultFormat::JSON_LINES;
+    }
+    if (name == "binary") {
+        return ResultFormat::BINARY;
+    }
+    throw std::runtime_error("Unknown result format: " + name);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
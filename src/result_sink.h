@@ -0,0 +1,67 @@
+#ifndef RESULT_SINK_H_20210219
+#define RESULT_SINK_H_20210219
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "landmarker.h"
+
+// -----------------------------------------------------------------------------
+// -------------------------------- Result Record ------------------------------
+// -----------------------------------------------------------------------------
+enum class ResultStatus : uint8_t {
+    OK = 0,
+    NO_FACE = 1,
+    FAILED = 2,
+};
+
+struct ResultRecord {
+    uint32_t mesh_idx = 0;  // Index in the file list (or frame index)
+    std::string filename;
+    ResultStatus status = ResultStatus::OK;
+    std::string error;  // Empty unless `FAILED`
+    float load_ms = 0.f, render_ms = 0.f, detect_ms = 0.f;  // Stage times
+    std::vector<Landmark> landmarks;
+};
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Result Sink -------------------------------
+// -----------------------------------------------------------------------------
+enum class ResultFormat {
+    JSON_LINES,  // One JSON object for each line
+    BINARY,      // "FLMKRES1" followed by records (native byte order)
+};
+
+// Binary record layout (after the 8-byte file magic):
+//   uint32 mesh_idx, uint8 status, uint8[3] padding,
+//   float load_ms, render_ms, detect_ms,
+//   uint32 filename bytes, uint32 error bytes, uint32 number of landmarks,
+//   filename, error,
+//   landmarks {int32 x, y; float X, Y, Z; uint32 vtx_idx}
+class ResultSink {
+public:
+    virtual ~ResultSink() = default;
+    virtual void write(const ResultRecord& record) = 0;
+    // Writes out buffered records (throws on I/O failure). Called by the
+    // destructor as well, where failures are ignored.
+    virtual void close() = 0;
+};
+
+// Buffered sink writing to a file ("-" for stdout). With `async`, records are
+// encoded and written by a background thread.
+std::unique_ptr<ResultSink> CreateResultSink(const std::string& filename,
+                                             ResultFormat format,
+                                             bool async = true);
+
+// Encodes a record as one line of `ResultFormat::JSON_LINES`
+void AppendJsonLine(std::string& buf, const ResultRecord& record);
+
+// Parses "jsonl" or "binary" (throws for others)
+ResultFormat ParseResultFormat(const std::string& name);
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
@@ -0,0 +1,479 @@
+#include "service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "log.h"
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+using Clock = std::chrono::steady_clock;
+
+float GetElapsedMs(const Clock::time_point& start) {
+    return std::chrono::duration<float, std::milli>(Clock::now() - start)
+            .count();
+}
+
+// Submits request lines of a connection, then waits for all of its responses
+// (`write` is called by one thread at a time)
+void ServeConnection(LandmarkService& service,
+                     const std::function<bool(std::string&)>& read_line,
+                     const std::function<void(const std::string&)>& write) {
+    std::mutex mutex;  // For `write` and `n_pending`
+    std::condition_variable responded;
+    uint32_t n_pending = 0;
+    const LandmarkService::Respond respond = [&](const ResultRecord& record) {
+        std::string buf;
+        AppendJsonLine(buf, record);
+        std::lock_guard<std::mutex> lock(mutex);
+        write(buf);
+        n_pending--;
+        responded.notify_all();
+    };
+
+    std::string line;
+    uint32_t request_idx = 0;
+    while (read_line(line)) {
+        line.erase(line.find_last_not_of(" \r") + 1);
+        if (line.empty()) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            n_pending++;
+        }
+        try {
+            service.submit(ParseServiceRequest(line), request_idx, respond);
+        } catch (const std::exception& e) {
+            ResultRecord record;
+            record.mesh_idx = request_idx;
+            record.filename = line;
+            record.status = ResultStatus::FAILED;
+            record.error = e.what();
+            respond(record);
+        }
+        request_idx++;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    responded.wait(lock, [&]() { return n_pending == 0; });
+}
+
+#ifndef _WIN32
+// Splits bytes of a socket into lines
+class FdLineReader {
+public:
+    explicit FdLineReader(int fd) : m_fd(fd) {}
+
+    bool readLine(std::string& line) {
+        while (true) {
+            const size_t end = m_buf.find('\n');
+            if (end != std::string::npos) {
+                line = m_buf.substr(0, end);
+                m_buf.erase(0, end + 1);
+                return true;
+            }
+            char tmp[4096];
+            const ssize_t n_read = ::read(m_fd, tmp, sizeof(tmp));
+            if (n_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n_read <= 0) {
+                // Last line without newline
+                line = std::move(m_buf);
+                m_buf.clear();
+                return !line.empty();
+            }
+            m_buf.append(tmp, static_cast<size_t>(n_read));
+        }
+    }
+
+private:
+    int m_fd;
+    std::string m_buf;
+};
+
+void WriteAll(int fd, const std::string& data) {
+    size_t n_written = 0;
+    while (n_written < data.size()) {
+        const ssize_t n = ::write(fd, data.data() + n_written,
+                                  data.size() - n_written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;  // Client has gone (its remaining results are dropped)
+        }
+        n_written += static_cast<size_t>(n);
+    }
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Service Request ------------------------------
+// -----------------------------------------------------------------------------
+ServiceRequest ParseServiceRequest(const std::string& line) {
+    ServiceRequest request;
+    const size_t tab_pos = line.find('\t');
+    request.filename = line.substr(0, tab_pos);
+    if (request.filename.empty()) {
+        throw std::runtime_error("Mesh path is empty");
+    }
+
+    // Pairs of yaw and pitch
+    if (tab_pos != std::string::npos) {
+        std::istringstream iss(line.substr(tab_pos + 1));
+        float yaw = 0.f, pitch = 0.f;
+        while (iss >> yaw) {
+            if (!(iss >> pitch)) {
+                throw std::runtime_error("Pitch is missing in view poses");
+            }
+            request.view_poses.emplace_back(yaw, pitch);
+        }
+        if (!iss.eof()) {
+            throw std::runtime_error("Invalid view poses: " +
+                                     line.substr(tab_pos + 1));
+        }
+    }
+    if (request.view_poses.empty()) {
+        request.view_poses.emplace_back(0.f, 0.f);
+    }
+    return request;
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Landmark Service -----------------------------
+// -----------------------------------------------------------------------------
+LandmarkService::LandmarkService(Renderer& renderer,
+                                 LandmarkDetectorPool& detectors,
+                                 const ServiceConfig& config)
+    : LandmarkService(std::vector<Renderer*>{&renderer}, detectors, config) {}
+
+LandmarkService::LandmarkService(const std::vector<Renderer*>& renderers,
+                                 LandmarkDetectorPool& detectors,
+                                 const ServiceConfig& config)
+    : m_renderers(renderers),
+      m_detectors(detectors),
+      m_config(config),
+      m_load_queue(config.queue_size),
+      m_render_queue(config.queue_size),
+      m_detect_queue(config.queue_size) {
+    if (!m_config.gen_mvp_mats) {
+        throw std::runtime_error("Service: View matrices are not given");
+    }
+    if (m_renderers.empty()) {
+        throw std::runtime_error("Service: No renderer is given");
+    }
+    // Colors are copied out of frames, and 3D points are found by ray casting
+    for (auto&& renderer : m_renderers) {
+        renderer->setColorFormat(ColorFormat::RGBA8);
+        renderer->setDenseReadback(false);
+    }
+
+    // Start workers
+    for (uint32_t i = 0; i < std::max(m_config.n_loaders, 1u); i++) {
+        m_load_threads.emplace_back([this]() { runLoader(); });
+    }
+    for (auto&& renderer : m_renderers) {
+        m_render_threads.emplace_back([this, renderer]() {
+            runRenderer(*renderer);
+        });
+    }
+    const uint32_t n_detectors =
+            (m_config.n_detectors == 0) ?
+                    std::max(std::thread::hardware_concurrency(), 1u) :
+                    m_config.n_detectors;
+    for (uint32_t i = 0; i < n_detectors; i++) {
+        m_detect_threads.emplace_back([this]() { runDetector(); });
+    }
+}
+
+LandmarkService::~LandmarkService() {
+    stop();
+}
+
+void LandmarkService::submit(const ServiceRequest& request,
+                             uint32_t request_idx, Respond respond) {
+    Job job;
+    job.request = request;
+    job.result.mesh_idx = request_idx;
+    job.result.filename = request.filename;
+    job.respond = respond;
+    if (!m_load_queue.push(std::move(job))) {
+        ResultRecord result;
+        result.mesh_idx = request_idx;
+        result.filename = request.filename;
+        result.status = ResultStatus::FAILED;
+        result.error = "Service is stopped";
+        respond(result);
+    }
+}
+
+void LandmarkService::stop() {
+    // Drain stage by stage
+    m_load_queue.close();
+    for (auto&& thread : m_load_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_render_queue.close();
+    for (auto&& thread : m_render_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_detect_queue.close();
+    for (auto&& thread : m_detect_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+std::shared_ptr<const Mesh> LandmarkService::loadMesh(
+        const std::string& filename) {
+    const auto mtime = std::filesystem::last_write_time(filename);
+
+    // Recently used one, or one being loaded by another loader
+    std::promise<std::shared_ptr<const Mesh>> promise;
+    bool is_registered = false;  // Others may wait for `promise`
+    {
+        std::unique_lock<std::mutex> lock(m_meshes_mutex);
+        for (auto it = m_meshes.begin(); it != m_meshes.end(); it++) {
+            if (it->filename == filename && it->mtime == mtime) {
+                m_meshes.splice(m_meshes.end(), m_meshes, it);
+                return m_meshes.back().mesh;
+            }
+        }
+        const auto loading_it = m_loading_meshes.find(filename);
+        if (loading_it != m_loading_meshes.end()) {
+            if (loading_it->second.mtime == mtime) {
+                auto loading = loading_it->second.mesh;
+                lock.unlock();
+                return loading.get();  // Rethrows its failure
+            }
+        } else {
+            m_loading_meshes.emplace(
+                    filename,
+                    LoadingMesh{mtime, promise.get_future().share()});
+            is_registered = true;
+        }
+    }
+
+    // Load and keep (the oldest one is released)
+    std::shared_ptr<const Mesh> mesh;
+    try {
+        mesh = std::make_shared<const Mesh>(
+                LoadMesh(filename, m_config.use_cache));
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m_meshes_mutex);
+        if (is_registered) {
+            m_loading_meshes.erase(filename);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+    std::lock_guard<std::mutex> lock(m_meshes_mutex);
+    if (is_registered) {
+        m_loading_meshes.erase(filename);
+    }
+    promise.set_value(mesh);
+    m_meshes.remove_if(
+            [&](const KeptMesh& kept) { return kept.filename == filename; });
+    m_meshes.push_back({filename, mtime, mesh});
+    while (m_config.n_kept_meshes < m_meshes.size()) {
+        m_meshes.pop_front();
+    }
+    return mesh;
+}
+
+void LandmarkService::runLoader() {
+    Job job;
+    while (m_load_queue.pop(job)) {
+        const auto start = Clock::now();
+        try {
+            job.mesh = loadMesh(job.request.filename);
+        } catch (const std::exception& e) {
+            job.result.error = e.what();
+        }
+        job.result.load_ms = GetElapsedMs(start);
+        if (!m_render_queue.push(std::move(job))) {
+            return;
+        }
+    }
+}
+
+void LandmarkService::runRenderer(Renderer& renderer) {
+    // The renderer is used by this thread only (its device stays resident,
+    // and a mesh of successive requests stays uploaded)
+    Job job;
+    while (m_render_queue.pop(job)) {
+        if (job.result.error.empty()) {
+            const auto start = Clock::now();
+            try {
+                const std::vector<glm::mat4> mvp_mats =
+                        m_config.gen_mvp_mats(*job.mesh,
+                                              job.request.view_poses);
+                renderer.setMesh(job.mesh);
+                // All views by one submission
+                for (auto&& view : renderer.drawBatchViews(mvp_mats)) {
+                    job.frames.push_back(CopyFrame(view));
+                }
+            } catch (const std::exception& e) {
+                job.result.error = e.what();
+            }
+            job.result.render_ms = GetElapsedMs(start);
+        }
+        if (!m_detect_queue.push(std::move(job))) {
+            return;
+        }
+    }
+}
+
+void LandmarkService::runDetector() {
+    Job job;
+    while (m_detect_queue.pop(job)) {
+        if (job.result.error.empty()) {
+            const auto start = Clock::now();
+            try {
+                auto detector = m_detectors.acquire();
+                job.result.landmarks =
+                        DetectRenderedFrames(*detector, job.frames, *job.mesh);
+            } catch (const std::exception& e) {
+                job.result.error = e.what();
+            }
+            job.result.detect_ms = GetElapsedMs(start);
+        }
+        if (!job.result.error.empty()) {
+            job.result.status = ResultStatus::FAILED;
+        } else if (job.result.landmarks.empty()) {
+            job.result.status = ResultStatus::NO_FACE;
+        }
+        job.mesh.reset();
+        job.frames.clear();
+
+        try {
+            job.respond(job.result);
+        } catch (const std::exception& e) {
+            Log(LogLevel::WARN, "Failed to respond: ", e.what());
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Service Frontends ----------------------------
+// -----------------------------------------------------------------------------
+void ServeStdin(LandmarkService& service) {
+    ServeConnection(
+            service,
+            [](std::string& line) {
+                return static_cast<bool>(std::getline(std::cin, line));
+            },
+            [](const std::string& data) {
+                std::fwrite(data.data(), 1, data.size(), stdout);
+                std::fflush(stdout);
+            });
+}
+
+void ServeUnixSocket(LandmarkService& service, const std::string& path) {
+#ifdef _WIN32
+    (void)service;
+    throw std::runtime_error("Unix socket is not supported: " + path);
+#else
+    sockaddr_un addr = {};
+    if (sizeof(addr.sun_path) <= path.size()) {
+        throw std::runtime_error("Too long socket path: " + path);
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // Listen (a socket file of a previous run is replaced)
+    const int server_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        throw std::runtime_error("Failed to create socket");
+    }
+    ::unlink(path.c_str());
+    if (::bind(server_fd, reinterpret_cast<const sockaddr*>(&addr),
+               sizeof(addr)) != 0 ||
+        ::listen(server_fd, SOMAXCONN) != 0) {
+        ::close(server_fd);
+        throw std::runtime_error("Failed to listen on " + path);
+    }
+    ::signal(SIGPIPE, SIG_IGN);  // Gone clients are found by write errors
+    Log(LogLevel::INFO, "Listening on ", path);
+
+    // Serve each client on its own thread
+    struct Client {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::list<Client> clients;
+    while (true) {
+        const int client_fd = ::accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Log(LogLevel::ERROR, "Failed to accept: ", std::strerror(errno));
+            break;
+        }
+
+        // Release finished ones
+        clients.remove_if([](Client& client) {
+            if (!client.done->load()) {
+                return false;
+            }
+            client.thread.join();
+            return true;
+        });
+
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        std::thread thread([&service, client_fd, done]() {
+            FdLineReader reader(client_fd);
+            ServeConnection(
+                    service,
+                    [&](std::string& line) { return reader.readLine(line); },
+                    [&](const std::string& data) {
+                        WriteAll(client_fd, data);
+                    });
+            ::close(client_fd);
+            done->store(true);
+        });
+        clients.push_back({std::move(thread), std::move(done)});
+    }
+
+    for (auto&& client : clients) {
+        client.thread.join();
+    }
+    ::close(server_fd);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
@@ -0,0 +1,131 @@
+#ifndef SERVICE_H_20210223
+#define SERVICE_H_20210223
+
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "bounded_queue.h"
+#include "landmarker.h"
+#include "renderer.h"
+#include "result_sink.h"
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Service Request ------------------------------
+// -----------------------------------------------------------------------------
+// One line of `<obj path>[\t<yaw> <pitch> [<yaw> <pitch> ...]]` (degrees).
+// Without poses, the mesh is seen from the front.
+struct ServiceRequest {
+    std::string filename;
+    std::vector<glm::vec2> view_poses;  // (yaw, pitch)
+};
+
+// Throws for malformed lines
+ServiceRequest ParseServiceRequest(const std::string& line);
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Landmark Service -----------------------------
+// -----------------------------------------------------------------------------
+struct ServiceConfig {
+    // View matrices of requested poses
+    std::function<std::vector<glm::mat4>(const Mesh&,
+                                         const std::vector<glm::vec2>&)>
+            gen_mvp_mats;
+    uint32_t n_loaders = 2;      // Threads loading meshes
+    uint32_t n_detectors = 0;    // Threads detecting landmarks (0: hardware)
+    uint32_t queue_size = 16;    // Capacity of each queue between stages
+    uint32_t n_kept_meshes = 8;  // Recently requested meshes kept loaded
+    bool use_cache = true;       // Mesh cache next to OBJ files
+};
+
+// Resident pipeline of the batch stages. The renderer (with its device and
+// pipeline) and the detectors are kept over requests, which are loaded,
+// rendered and detected concurrently.
+class LandmarkService {
+public:
+    using Respond = std::function<void(const ResultRecord&)>;
+
+    LandmarkService(Renderer& renderer, LandmarkDetectorPool& detectors,
+                    const ServiceConfig& config);
+    // A render thread for each renderer (e.g. sessions of a `RenderContext`,
+    // which draw meshes concurrently on one device)
+    LandmarkService(const std::vector<Renderer*>& renderers,
+                    LandmarkDetectorPool& detectors,
+                    const ServiceConfig& config);
+    ~LandmarkService();
+    LandmarkService(const LandmarkService&) = delete;
+    LandmarkService& operator=(const LandmarkService&) = delete;
+
+    // Queues a request (waits while the queue is full). `respond` is called
+    // once on a worker thread, also for failures.
+    void submit(const ServiceRequest& request, uint32_t request_idx,
+                Respond respond);
+    // Finishes queued requests and stops workers
+    void stop();
+
+private:
+    struct Job {
+        ServiceRequest request;
+        ResultRecord result;
+        Respond respond;
+        std::shared_ptr<const Mesh> mesh;
+        std::vector<RenderedFrame> frames;
+    };
+
+    std::shared_ptr<const Mesh> loadMesh(const std::string& filename);
+    void runLoader();
+    void runRenderer(Renderer& renderer);
+    void runDetector();
+
+    std::vector<Renderer*> m_renderers;
+    LandmarkDetectorPool& m_detectors;
+    ServiceConfig m_config;
+
+    // Recently used meshes with OBJ modification times (newest at back)
+    struct KeptMesh {
+        std::string filename;
+        std::filesystem::file_time_type mtime;
+        std::shared_ptr<const Mesh> mesh;
+    };
+    // Meshes being loaded, waited by other loaders requesting them
+    struct LoadingMesh {
+        std::filesystem::file_time_type mtime;
+        std::shared_future<std::shared_ptr<const Mesh>> mesh;
+    };
+    std::mutex m_meshes_mutex;
+    std::list<KeptMesh> m_meshes;
+    std::map<std::string, LoadingMesh> m_loading_meshes;
+
+    BoundedQueue<Job> m_load_queue;
+    BoundedQueue<Job> m_render_queue;
+    BoundedQueue<Job> m_detect_queue;
+    std::vector<std::thread> m_load_threads;
+    std::vector<std::thread> m_render_threads;
+    std::vector<std::thread> m_detect_threads;
+};
+
+// -----------------------------------------------------------------------------
+// ------------------------------ Service Frontends ----------------------------
+// -----------------------------------------------------------------------------
+// Serves request lines of stdin with JSON Lines on stdout until EOF.
+// Responses are written in completion order (`mesh_idx` is the index of the
+// request in the stream).
+void ServeStdin(LandmarkService& service);
+
+// Serves clients of a Unix domain socket (same protocol as stdin, one thread
+// for each connection). Runs until the socket fails.
+void ServeUnixSocket(LandmarkService& service, const std::string& path);
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */
@@ -0,0 +1,60 @@
+#version 460
+
+// `WINDOW_OUTPUT` is defined for rendering with window
+// `ID_OUTPUT` is defined for vertex index output (`gl_PrimitiveID` needs the
+// geometry shader feature)
+
+// Layout of `Vertex` in 32-bit words (checked in renderer.cpp)
+#define VTX_WORDS 6     // sizeof(Vertex) / 4
+#define VTX_IDX_WORD 5  // offsetof(Vertex, vtx_idx) / 4
+
+layout (binding = 1) uniform sampler2D tex;
+layout (std430, binding = 2) readonly buffer IndexBuffer {
+    uint indices[];
+};
+layout (std430, binding = 3) readonly buffer VertexBuffer {
+    uint vtx_words[];  // Packed `Vertex`
+};
+
+layout (location = 0) in vec3 vtx_pos;
+layout (location = 1) in vec2 vtx_uv;
+
+#ifdef WINDOW_OUTPUT
+layout (location = 0) out vec4 frag_window;
+layout (location = 1) out vec4 frag_color;
+layout (location = 2) out vec4 frag_pos;
+#ifdef ID_OUTPUT
+layout (location = 3) out uint frag_id;
+#endif
+#else
+layout (location = 0) out vec4 frag_color;
+layout (location = 1) out vec4 frag_pos;
+#ifdef ID_OUTPUT
+layout (location = 2) out uint frag_id;
+#endif
+#endif
+
+void main() {
+    vec2 uv = vec2(vtx_uv.x, 1.0 - vtx_uv.y);  // Y-flip
+    frag_color = texture(tex, uv);
+    frag_pos = vec4(vtx_pos, 1.0);
+#ifdef WINDOW_OUTPUT
+    frag_window = frag_color;  // debug output
+#endif
+
+#ifdef ID_OUTPUT
+    // Vertex index of the nearest corner
+    float min_dist = 3.402823e+38;
+    for (int k = 0; k < 3; k++) {
+        uint w = indices[gl_PrimitiveID * 3 + k] * VTX_WORDS;
+        vec3 corner = vec3(uintBitsToFloat(vtx_words[w + 0]),
+                           uintBitsToFloat(vtx_words[w + 1]),
+                           uintBitsToFloat(vtx_words[w + 2]));
+        float dist = distance(corner, vtx_pos);
+        if (dist < min_dist) {
+            min_dist = dist;
+            frag_id = vtx_words[w + VTX_IDX_WORD];
+        }
+    }
+#endif
+}
@@ -0,0 +1,17 @@
+#version 460
+
+layout(binding = 0) uniform UniformBuffer {
+    mat4 mvp_mat;
+} uniform_buf;
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec2 uv;
+
+layout (location = 0) out vec3 vtx_pos;
+layout (location = 1) out vec2 vtx_uv;
+
+void main() {
+    gl_Position = uniform_buf.mvp_mat * vec4(pos, 1.0);
+    vtx_pos = pos;
+    vtx_uv = uv;
+}
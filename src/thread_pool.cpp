@@ -0,0 +1,112 @@
+#include "thread_pool.h"
+
+#include <exception>
+#include <memory>
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Thread Pool -------------------------------
+// -----------------------------------------------------------------------------
+ThreadPool::ThreadPool(uint32_t n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    // The caller of `parallelFor` works too, so spawn one less
+    for (uint32_t i = 1; i < n_threads; i++) {
+        m_threads.emplace_back([this]() { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_cond.notify_all();
+    for (auto&& thread : m_threads) {
+        thread.join();
+    }
+}
+
+uint32_t ThreadPool::getNumThreads() const {
+    return static_cast<uint32_t>(m_threads.size()) + 1;
+}
+
+void ThreadPool::parallelFor(uint32_t n_tasks,
+                             const std::function<void(uint32_t)>& func) {
+    if (n_tasks == 0) {
+        return;
+    }
+
+    // Shared state between the caller and helpers
+    struct State {
+        std::atomic<uint32_t> next_idx{0};
+        std::atomic<uint32_t> n_done{0};
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::exception_ptr error;  // The first exception thrown by tasks
+    };
+    auto state = std::make_shared<State>();
+    auto consume = [state, n_tasks, &func]() {
+        uint32_t idx;
+        while ((idx = state->next_idx.fetch_add(1)) < n_tasks) {
+            try {
+                func(idx);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->n_done.fetch_add(1) + 1 == n_tasks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->cond.notify_all();
+            }
+        }
+    };
+
+    // Wake helpers (they may find no work left, which is fine)
+    const uint32_t n_helpers = std::min(
+            static_cast<uint32_t>(m_threads.size()), n_tasks - 1);
+    if (0 < n_helpers) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32_t i = 0; i < n_helpers; i++) {
+            m_jobs.emplace_back(consume);
+        }
+    }
+    m_cond.notify_all();
+
+    // Work on the calling thread as well
+    consume();
+
+    // Wait for tasks taken by helpers
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cond.wait(lock, [&]() { return state->n_done == n_tasks; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&]() { return m_exit || !m_jobs.empty(); });
+            if (m_exit && m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+ThreadPool& GetThreadPool() {
+    static ThreadPool s_pool;
+    return s_pool;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
@@ -0,0 +1,47 @@
+#ifndef THREAD_POOL_H_20210214
+#define THREAD_POOL_H_20210214
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// --------------------------------- Thread Pool -------------------------------
+// -----------------------------------------------------------------------------
+class ThreadPool {
+public:
+    ThreadPool(uint32_t n_threads = 0);  // 0: Number of hardware threads
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t getNumThreads() const;
+
+    // Calls `func(i)` for all `i` in [0, n_tasks), blocking until finished.
+    // The calling thread also consumes tasks, so nesting is allowed. The first
+    // exception thrown by `func` is rethrown after all tasks finished.
+    void parallelFor(uint32_t n_tasks,
+                     const std::function<void(uint32_t)>& func);
+
+private:
+    void work();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_exit = false;
+};
+
+// Shared pool sized by hardware concurrency
+ThreadPool& GetThreadPool();
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+#endif /* end of include guard */